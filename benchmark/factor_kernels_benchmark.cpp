@@ -0,0 +1,240 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_simd.h"
+
+using namespace BN;
+
+/*
+  compares the index-vector factor operations the library used before the strided kernels,
+  the scalar kernels and the SIMD kernels picked for this CPU,
+  for binary-variable tables of 2^10 to 2^24 entries
+*/
+
+namespace legacy
+{
+
+// previous factor_product, gathers through get_state_indices of the first shared variable.
+// it is only correct with one shared variable, so it is benchmarked on the broadcast product only
+void factor_product(const factor& factor_left, 
+                    const factor& factor_right,
+                          factor& product_result)
+{
+  UIntVec intersection_indices_left, intersection_indices_right;
+  get_intersection(factor_left.variables, 
+                   factor_right.variables, 
+                   intersection_indices_left,
+                   intersection_indices_right);
+
+  product_result.variables.clear();
+  product_result.cardinals.clear();
+  product_result.variables.push_back(factor_left.variables[intersection_indices_left[0]]);
+  product_result.cardinals.push_back(factor_left.cardinals[intersection_indices_left[0]]);
+  for (std::size_t iter = 0u; iter < factor_left.variables.size(); iter++)
+  {
+    if (iter != intersection_indices_left[0])
+    {
+      product_result.variables.push_back(factor_left.variables[iter]);
+      product_result.cardinals.push_back(factor_left.cardinals[iter]);
+    }
+  }
+  for (std::size_t iter = 0u; iter < factor_right.variables.size(); iter++)
+  {
+    if (iter != intersection_indices_right[0])
+    {
+      product_result.variables.push_back(factor_right.variables[iter]);
+      product_result.cardinals.push_back(factor_right.cardinals[iter]);
+    }
+  }
+  product_result.values = std::vector<float> (util::vec_prod(product_result.cardinals), 0.0F);
+
+  std::vector<UIntVec> indices_left, indices_right, indices_prod;
+  get_state_indices(factor_left,    intersection_indices_left[0],  indices_left);
+  get_state_indices(factor_right,   intersection_indices_right[0], indices_right);
+  get_state_indices(product_result, 0, indices_prod); 
+
+  UInt iter_prod;
+  for (std::size_t state = 0; state < indices_prod.size(); state++)
+  {
+    iter_prod = 0u;
+    for (std::size_t iter_right = 0; iter_right < indices_right[state].size(); iter_right++)
+    {
+      for (std::size_t iter_left = 0; iter_left < indices_left[state].size(); iter_left++)
+      {
+        product_result.values[indices_prod[state][iter_prod]] = factor_left.values[indices_left[state][iter_left]];
+        product_result.values[indices_prod[state][iter_prod]] *= factor_right.values[indices_right[state][iter_right]];
+        ++iter_prod;
+      }
+    }
+  }
+}
+
+
+// previous factor_marginalize, one variable at a time through get_state_indices
+void factor_marginalize(const factor& factor_marginalize,
+                        const UInt    var_index,
+                              factor& marginal_result)
+{
+  marginal_result.variables.clear();
+  marginal_result.cardinals.clear();
+  marginal_result.values.clear();
+  for (std::size_t source_iter = 0u; source_iter < factor_marginalize.variables.size(); source_iter++)
+  {
+    if (source_iter != var_index)
+    {
+      marginal_result.variables.push_back(factor_marginalize.variables[source_iter]);
+      marginal_result.cardinals.push_back(factor_marginalize.cardinals[source_iter]);
+    }
+  }
+  marginal_result.values.reserve(util::vec_prod(marginal_result.cardinals));
+
+  std::vector<UIntVec> factor_indices;
+  get_state_indices(factor_marginalize, var_index, factor_indices);
+  for (std::size_t iter = 0u; iter < factor_indices[0u].size(); iter++)
+  {
+    float result = 0.0f;
+    for (std::size_t state = 0u; state < factor_indices.size(); state++)
+    {  result += factor_marginalize.values[factor_indices[state][iter]];  }
+    marginal_result.values.push_back(result);
+  }
+}
+
+
+// previous factor_normalize
+void factor_normalize(factor& factor_to_normalize)
+{
+  float probability_sum = util::vec_sum_n(factor_to_normalize.values, factor_to_normalize.values.size());
+  util::vec_divide_n(factor_to_normalize.values, probability_sum, factor_to_normalize.values.size());
+}
+
+} // end namespace {legacy}
+
+factor make_binary_factor(const UInt first_var, const UInt num_vars)
+{
+  factor return_elem;
+  for (UInt var = first_var; var < first_var + num_vars; var++)
+  {
+    return_elem.variables.push_back(var);
+    return_elem.cardinals.push_back(2u);
+  }
+  return_elem.values.resize(1u << num_vars);
+  for (std::size_t iter = 0u; iter < return_elem.values.size(); iter++)
+  {  return_elem.values[iter] = 0.5f + static_cast<float>(iter % 7u)*0.01f;  }
+  return return_elem;
+}
+
+
+double time_ms(const std::function<void()>& operation, const UInt repetitions)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (UInt iter = 0u; iter < repetitions; iter++)
+  {  operation();  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count()/repetitions;
+}
+
+
+// get_state_indices reallocates its index vectors for every range, the previous path grows
+// much faster than linearly and is only timed up to this many variables, with a few repetitions
+const UInt LEGACY_MAX_VARS    = 16u;
+const UInt LEGACY_REPETITIONS = 4u;
+
+
+void benchmark_legacy(const UInt num_vars, 
+                      std::vector<double>& timings)
+{
+  factor joint    = make_binary_factor(0u, num_vars);
+  factor last_var = make_binary_factor(num_vars - 1u, 1u);
+  factor result, temp;
+
+  // same-scope product shares every variable, the previous path can't compute it
+  timings.assign(1u, 0.0);
+  if (num_vars > LEGACY_MAX_VARS)
+  {
+    timings.resize(5u, 0.0);
+    return;
+  }
+  timings.push_back(time_ms([&]() { legacy::factor_product(joint, last_var, result); }, LEGACY_REPETITIONS));
+  timings.push_back(time_ms([&]() { legacy::factor_marginalize(joint, num_vars - 1u, result); }, LEGACY_REPETITIONS));
+  timings.push_back(time_ms([&]() 
+  { 
+    legacy::factor_marginalize(joint, 0u, result);
+    while (result.variables.size() > 1u)
+    {
+      legacy::factor_marginalize(result, 0u, temp);
+      std::swap(result, temp);
+    }
+  }, LEGACY_REPETITIONS));
+  timings.push_back(time_ms([&]() { legacy::factor_normalize(joint); }, LEGACY_REPETITIONS));
+}
+
+
+void benchmark_level(const simd_level level, 
+                     const UInt       num_vars, 
+                     const UInt       repetitions, 
+                     std::vector<double>& timings)
+{
+  set_simd_level(level);
+
+  factor joint      = make_binary_factor(0u, num_vars);
+  factor same_scope = make_binary_factor(0u, num_vars);
+  factor last_var   = make_binary_factor(num_vars - 1u, 1u);
+  factor result;
+
+  timings.clear();
+  timings.push_back(time_ms([&]() { factor_product(joint, same_scope, result); }, repetitions));
+  timings.push_back(time_ms([&]() { factor_product(joint, last_var, result); }, repetitions));
+  timings.push_back(time_ms([&]() { factor_sum_out(joint, UIntVec{num_vars - 1u}, result); }, repetitions));
+
+  UIntVec all_but_last;
+  for (UInt var = 0u; var + 1u < num_vars; var++) {  all_but_last.push_back(var);  }
+  timings.push_back(time_ms([&]() { factor_sum_out(joint, all_but_last, result); }, repetitions));
+  timings.push_back(time_ms([&]() { factor_normalize(joint); }, repetitions));
+}
+
+
+int main()
+{
+  const simd_level best_level = detect_simd_level();
+  const char* level_names[] = {"scalar", "avx2", "avx512"};
+  std::cout << "SIMD level: " << level_names[best_level] << "\n";
+  std::cout << "time per call in ms, index-vector / scalar / simd (speedup of simd over index-vector)\n";
+  std::cout << std::setw(8)  << "entries"
+            << std::setw(38) << "product(same scope)"
+            << std::setw(38) << "product(broadcast)"
+            << std::setw(38) << "sum_out(last var)"
+            << std::setw(38) << "sum_out(all but last)"
+            << std::setw(38) << "normalize" << '\n';
+
+  for (UInt num_vars = 10u; num_vars <= 24u; num_vars += 2u)
+  {
+    const UInt repetitions = std::max(1u, (1u << 24u) >> num_vars);
+    std::vector<double> legacy_timings, scalar_timings, simd_timings;
+    benchmark_legacy(num_vars, legacy_timings);
+    benchmark_level(SIMD_SCALAR, num_vars, repetitions, scalar_timings);
+    benchmark_level(best_level,  num_vars, repetitions, simd_timings);
+
+    std::cout << std::setw(6) << "2^" << std::left << std::setw(2) << num_vars << std::right;
+    for (std::size_t iter = 0u; iter < scalar_timings.size(); iter++)
+    {
+      std::cout << std::fixed << std::setprecision(3);
+      if (legacy_timings[iter] > 0.0)
+      {  std::cout << std::setw(10) << legacy_timings[iter] << " / ";  }
+      else
+      {  std::cout << std::setw(10) << "-" << " / ";  }
+      std::cout << std::setw(8) << scalar_timings[iter] << " / "
+                << std::setw(8) << simd_timings[iter];
+      if (legacy_timings[iter] > 0.0)
+      {  std::cout << " (" << std::setw(5) << std::setprecision(1) << legacy_timings[iter]/simd_timings[iter] << "x)";  }
+      else
+      {  std::cout << std::setw(9) << " ";  }
+    }
+    std::cout << '\n';
+  }
+  set_simd_level(best_level);
+}
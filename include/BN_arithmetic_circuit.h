@@ -0,0 +1,448 @@
+#ifndef _BN_ARITHMETIC_CIRCUIT_H_
+#define _BN_ARITHMETIC_CIRCUIT_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_variable_elimination.h"
+#include "util.h"
+
+namespace BN
+{
+
+enum circuit_node_type
+{
+  AC_INDICATOR = 0,
+  AC_PARAMETER = 1,
+  AC_ADD       = 2,
+  AC_MULTIPLY  = 3
+};
+
+// shared constant leaves, every zero parameter and every product with one of them folds into these
+const UInt AC_ZERO_NODE = 0u;
+const UInt AC_ONE_NODE  = 1u;
+
+
+struct arithmeticCircuit
+{
+  // nodes in topological order, children always come before their parents,
+  // children of node n are children[child_offsets[n] .. child_offsets[n+1])
+  // multiply nodes always have exactly two children
+  std::vector<circuit_node_type> node_types;
+  UIntVec                        child_offsets;
+  UIntVec                        children;
+
+  // CPD value of parameter leaves, 1 for indicator leaves, not used by internal nodes
+  std::vector<float> leaf_values;
+
+  // indicator leaf of state s of var is indicator_offset[var] + s
+  std::map<UInt, UInt> indicator_offset;
+  std::map<UInt, UInt> var_cardinals;
+
+  UInt root = AC_ONE_NODE;
+  elimination_stats compile_stats;
+
+  // filled by the upward/downward passes
+  std::vector<UIntVec> evidence;
+  std::vector<float>   values;
+  std::vector<float>   derivatives;
+  float                evidence_probability = 0.0f;
+};
+
+
+// table of circuit nodes over a scope, used while compiling, laid out the same way as BN::factor
+struct circuitFactor
+{
+  UIntVec variables;
+  UIntVec cardinals;
+  UIntVec nodes;
+};
+
+
+UInt add_circuit_leaf(arithmeticCircuit&      circuit,
+                      const circuit_node_type node_type,
+                      const float             leaf_value)
+{
+  // children of the new node (if any) are already at the back of circuit.children
+  circuit.node_types.push_back(node_type);
+  circuit.leaf_values.push_back(leaf_value);
+  circuit.child_offsets.push_back(static_cast<UInt>(circuit.children.size()));
+  return static_cast<UInt>(circuit.node_types.size() - 1u);
+}
+
+
+UInt add_circuit_multiply(arithmeticCircuit& circuit,
+                          const UInt         child1,
+                          const UInt         child2)
+{
+  if ((child1 == AC_ZERO_NODE) || (child2 == AC_ZERO_NODE))
+  {  return AC_ZERO_NODE;  }
+  if (child1 == AC_ONE_NODE)
+  {  return child2;  }
+  if (child2 == AC_ONE_NODE)
+  {  return child1;  }
+
+  circuit.children.push_back(child1);
+  circuit.children.push_back(child2);
+  return add_circuit_leaf(circuit, AC_MULTIPLY, 0.0f);
+}
+
+
+UInt add_circuit_add(arithmeticCircuit& circuit,
+                     const UIntVec&     add_children)
+{
+  // zero terms are dropped, a single term is used as is
+  const std::size_t children_begin = circuit.children.size();
+  for (const UInt child: add_children)
+  {
+    if (child != AC_ZERO_NODE)
+    {  circuit.children.push_back(child);  }
+  }
+
+  const std::size_t num_children = circuit.children.size() - children_begin;
+  if (num_children <= 1u)
+  {
+    const UInt result = (num_children == 0u) ? AC_ZERO_NODE : circuit.children.back();
+    circuit.children.resize(children_begin);
+    return result;
+  }
+  return add_circuit_leaf(circuit, AC_ADD, 0.0f);
+}
+
+
+void circuit_factor_product(const circuitFactor&     factor_left,
+                            const circuitFactor&     factor_right,
+                                  arithmeticCircuit& circuit,
+                                  circuitFactor&     product_result)
+{
+  // same scope and odometer as factor_product, every table entry becomes a multiply node
+  product_result.variables = factor_left.variables;
+  product_result.cardinals = factor_left.cardinals;
+  for (std::size_t iter = 0u; iter < factor_right.variables.size(); iter++)
+  {
+    if (std::find(factor_left.variables.begin(), factor_left.variables.end(), factor_right.variables[iter]) == factor_left.variables.end())
+    {
+      product_result.variables.push_back(factor_right.variables[iter]);
+      product_result.cardinals.push_back(factor_right.cardinals[iter]);
+    }
+  }
+
+  const std::size_t num_vars = product_result.variables.size();
+  UIntVec strides_left(num_vars, 0u), strides_right(num_vars, 0u);
+  UInt stride_left = 1u, stride_right = 1u;
+  for (std::size_t iter = 0u; iter < factor_left.variables.size(); iter++)
+  {
+    strides_left[iter] = stride_left;
+    stride_left       *= factor_left.cardinals[iter];
+  }
+  for (std::size_t iter = 0u; iter < factor_right.variables.size(); iter++)
+  {
+    const std::size_t product_index = std::find(product_result.variables.begin(), product_result.variables.end(), factor_right.variables[iter])
+                                    - product_result.variables.begin();
+    strides_right[product_index] = stride_right;
+    stride_right                *= factor_right.cardinals[iter];
+  }
+
+  const UInt num_values = util::vec_prod(product_result.cardinals);
+  product_result.nodes.resize(num_values);
+  UIntVec assignment(num_vars, 0u);
+  UInt idx_left = 0u, idx_right = 0u;
+  for (UInt iter_prod = 0u; iter_prod < num_values; iter_prod++)
+  {
+    product_result.nodes[iter_prod] = add_circuit_multiply(circuit, factor_left.nodes[idx_left], factor_right.nodes[idx_right]);
+
+    for (std::size_t var_iter = 0u; var_iter < num_vars; var_iter++)
+    {
+      assignment[var_iter]++;
+      if (assignment[var_iter] < product_result.cardinals[var_iter])
+      {
+        idx_left  += strides_left[var_iter];
+        idx_right += strides_right[var_iter];
+        break;
+      }
+      assignment[var_iter] = 0u;
+      idx_left  -= (product_result.cardinals[var_iter] - 1u)*strides_left[var_iter];
+      idx_right -= (product_result.cardinals[var_iter] - 1u)*strides_right[var_iter];
+    }
+  }
+}
+
+
+void circuit_factor_sum_out(const circuitFactor&     factor_to_sum,
+                            const UInt               sum_out_var,
+                                  arithmeticCircuit& circuit,
+                                  circuitFactor&     sum_result)
+{
+  // every result entry becomes one add node over the states of sum_out_var
+  sum_result.variables.clear();
+  sum_result.cardinals.clear();
+  UInt sum_out_cardinal = 1u, sum_out_stride = 1u, stride = 1u;
+  UIntVec kept_strides;
+  for (std::size_t iter = 0u; iter < factor_to_sum.variables.size(); iter++)
+  {
+    if (factor_to_sum.variables[iter] == sum_out_var)
+    {
+      sum_out_cardinal = factor_to_sum.cardinals[iter];
+      sum_out_stride   = stride;
+    }
+    else
+    {
+      sum_result.variables.push_back(factor_to_sum.variables[iter]);
+      sum_result.cardinals.push_back(factor_to_sum.cardinals[iter]);
+      kept_strides.push_back(stride);
+    }
+    stride *= factor_to_sum.cardinals[iter];
+  }
+
+  const UInt num_values = util::vec_prod(sum_result.cardinals);
+  sum_result.nodes.resize(num_values);
+  UIntVec assignment(sum_result.variables.size(), 0u);
+  UIntVec add_children(sum_out_cardinal);
+  UInt idx_source = 0u;
+  for (UInt iter_result = 0u; iter_result < num_values; iter_result++)
+  {
+    for (UInt state = 0u; state < sum_out_cardinal; state++)
+    {  add_children[state] = factor_to_sum.nodes[idx_source + state*sum_out_stride];  }
+    sum_result.nodes[iter_result] = add_circuit_add(circuit, add_children);
+
+    for (std::size_t var_iter = 0u; var_iter < sum_result.variables.size(); var_iter++)
+    {
+      assignment[var_iter]++;
+      if (assignment[var_iter] < sum_result.cardinals[var_iter])
+      {
+        idx_source += kept_strides[var_iter];
+        break;
+      }
+      assignment[var_iter] = 0u;
+      idx_source -= (sum_result.cardinals[var_iter] - 1u)*kept_strides[var_iter];
+    }
+  }
+}
+
+
+void compile_arithmetic_circuit(const std::vector<factor*>&  factor_vec,
+                                const elimination_heuristic  heuristic,
+                                      arithmeticCircuit&     circuit)
+{
+  // variable elimination is run once on tables of circuit nodes instead of numbers,
+  // the recorded adds and multiplies form the circuit, evidence enters through the indicators
+  if (factor_vec.empty() == true)
+  {
+    std::cout << "Cannot compile arithmetic circuit, given factor vector is empty\n";
+    return;
+  }
+
+  circuit = arithmeticCircuit();
+  circuit.child_offsets.push_back(0u);
+  add_circuit_leaf(circuit, AC_PARAMETER, 0.0f);
+  add_circuit_leaf(circuit, AC_PARAMETER, 1.0f);
+
+  // indicators of each variable are contiguous
+  std::vector<circuitFactor> factors;
+  for (const factor* factor_ptr: factor_vec)
+  {
+    for (std::size_t iter = 0u; iter < factor_ptr->variables.size(); iter++)
+    {  circuit.var_cardinals[factor_ptr->variables[iter]] = factor_ptr->cardinals[iter];  }
+  }
+  for (const std::pair<const UInt, UInt>& var_cardinal: circuit.var_cardinals)
+  {
+    circuitFactor indicator;
+    indicator.variables = UIntVec{var_cardinal.first};
+    indicator.cardinals = UIntVec{var_cardinal.second};
+    circuit.indicator_offset[var_cardinal.first] = static_cast<UInt>(circuit.node_types.size());
+    for (UInt state = 0u; state < var_cardinal.second; state++)
+    {  indicator.nodes.push_back(add_circuit_leaf(circuit, AC_INDICATOR, 1.0f));  }
+    factors.push_back(std::move(indicator));
+  }
+
+  // zero and one parameters share the constant leaves
+  for (const factor* factor_ptr: factor_vec)
+  {
+    circuitFactor parameters;
+    parameters.variables = factor_ptr->variables;
+    parameters.cardinals = factor_ptr->cardinals;
+    for (const float value: factor_ptr->values)
+    {
+      if      (value == 0.0f) {  parameters.nodes.push_back(AC_ZERO_NODE);  }
+      else if (value == 1.0f) {  parameters.nodes.push_back(AC_ONE_NODE);   }
+      else                    {  parameters.nodes.push_back(add_circuit_leaf(circuit, AC_PARAMETER, value));  }
+    }
+    factors.push_back(std::move(parameters));
+  }
+
+  UIntVec all_vars;
+  for (const std::pair<const UInt, UInt>& var_cardinal: circuit.var_cardinals)
+  {  all_vars.push_back(var_cardinal.first);  }
+  get_elimination_order(factor_vec, all_vars, heuristic, circuit.compile_stats);
+
+  circuitFactor product, temp;
+  for (const UInt var: circuit.compile_stats.elimination_order)
+  {
+    bool has_product = false;
+    std::vector<circuitFactor> remaining;
+    for (circuitFactor& factor_elem: factors)
+    {
+      if (std::find(factor_elem.variables.begin(), factor_elem.variables.end(), var) == factor_elem.variables.end())
+      {
+        remaining.push_back(std::move(factor_elem));
+      }
+      else if (has_product == false)
+      {
+        product     = std::move(factor_elem);
+        has_product = true;
+      }
+      else
+      {
+        circuit_factor_product(product, factor_elem, circuit, temp);
+        std::swap(product, temp);
+      }
+    }
+    factors = std::move(remaining);
+
+    if (has_product == true)
+    {
+      factors.push_back(circuitFactor());
+      circuit_factor_sum_out(product, var, circuit, factors.back());
+    }
+  }
+
+  // only scalars are left
+  circuit.root = AC_ONE_NODE;
+  for (const circuitFactor& factor_elem: factors)
+  {  circuit.root = add_circuit_multiply(circuit, circuit.root, factor_elem.nodes[0]);  }
+
+  circuit.values.resize(circuit.node_types.size());
+  circuit.derivatives.resize(circuit.node_types.size());
+}
+
+
+void circuit_upward_pass(const std::vector<UIntVec>& evidence,
+                               arithmeticCircuit&    circuit)
+{
+  // value of every node under the evidence, root value is P(evidence)
+  circuit.evidence = evidence;
+  circuit.values   = circuit.leaf_values;
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    std::map<UInt, UInt>::const_iterator indicator = circuit.indicator_offset.find(evidence_elem[0]);
+    if (   (indicator == circuit.indicator_offset.end())
+        || (evidence_elem[1] >= circuit.var_cardinals[evidence_elem[0]]) )
+    {  continue;  }
+
+    for (UInt state = 0u; state < circuit.var_cardinals[evidence_elem[0]]; state++)
+    {
+      if (state != evidence_elem[1])
+      {  circuit.values[indicator->second + state] = 0.0f;  }
+    }
+  }
+
+  const std::size_t num_nodes = circuit.node_types.size();
+  for (std::size_t node = 0u; node < num_nodes; node++)
+  {
+    const UInt* node_children = circuit.children.data() + circuit.child_offsets[node];
+    if (circuit.node_types[node] == AC_MULTIPLY)
+    {
+      circuit.values[node] = circuit.values[node_children[0]]*circuit.values[node_children[1]];
+    }
+    else if (circuit.node_types[node] == AC_ADD)
+    {
+      const UInt num_children = circuit.child_offsets[node + 1u] - circuit.child_offsets[node];
+      float total = 0.0f;
+      for (UInt iter = 0u; iter < num_children; iter++)
+      {  total += circuit.values[node_children[iter]];  }
+      circuit.values[node] = total;
+    }
+  }
+  circuit.evidence_probability = circuit.values[circuit.root];
+}
+
+
+void circuit_downward_pass(arithmeticCircuit& circuit)
+{
+  // partial derivative of the root with respect to every node, in reverse topological order,
+  // derivative of the indicator of var = s is P(var = s, evidence without var)
+  circuit.derivatives.assign(circuit.node_types.size(), 0.0f);
+  circuit.derivatives[circuit.root] = 1.0f;
+
+  for (std::size_t node = circuit.root + 1u; node-- > 0u; )
+  {
+    const float node_derivative = circuit.derivatives[node];
+    if (node_derivative == 0.0f)
+    {  continue;  }
+
+    const UInt* node_children = circuit.children.data() + circuit.child_offsets[node];
+    if (circuit.node_types[node] == AC_MULTIPLY)
+    {
+      circuit.derivatives[node_children[0]] += node_derivative*circuit.values[node_children[1]];
+      circuit.derivatives[node_children[1]] += node_derivative*circuit.values[node_children[0]];
+    }
+    else if (circuit.node_types[node] == AC_ADD)
+    {
+      const UInt num_children = circuit.child_offsets[node + 1u] - circuit.child_offsets[node];
+      for (UInt iter = 0u; iter < num_children; iter++)
+      {  circuit.derivatives[node_children[iter]] += node_derivative;  }
+    }
+  }
+}
+
+
+void get_node_marginal(const arithmeticCircuit& circuit,
+                       const UInt               var,
+                             factor&            factor_marg)
+{
+  std::map<UInt, UInt>::const_iterator indicator = circuit.indicator_offset.find(var);
+  if (indicator == circuit.indicator_offset.end())
+  {
+    std::cout << "given variable -> " << var << " not found in arithmetic circuit\n";
+    return;
+  }
+
+  const UInt cardinal = circuit.var_cardinals.at(var);
+  factor_marg.variables = UIntVec{var};
+  factor_marg.cardinals = UIntVec{cardinal};
+  factor_marg.values.assign(cardinal, 0.0f);
+
+  for (const UIntVec& evidence_elem: circuit.evidence)
+  {
+    if (   (evidence_elem[0] == var)
+        && (evidence_elem[1] <  cardinal) )
+    {
+      factor_marg.values[evidence_elem[1]] = 1.0f;
+      return;
+    }
+  }
+
+  for (UInt state = 0u; state < cardinal; state++)
+  {  factor_marg.values[state] = circuit.derivatives[indicator->second + state];  }
+  factor_normalize(factor_marg);
+}
+
+
+void compute_all_marginals(const std::vector<UIntVec>&   evidence,
+                                 arithmeticCircuit&      circuit,
+                                 std::map<UInt, factor>& marginals)
+{
+  // one upward and one downward pass give the marginal of every variable
+  circuit_upward_pass(evidence, circuit);
+  if (circuit.evidence_probability == 0.0f)
+  {
+    std::cout << "given evidence has zero probability\n";
+    return;
+  }
+  circuit_downward_pass(circuit);
+
+  for (const std::pair<const UInt, UInt>& var_indicator: circuit.indicator_offset)
+  {
+    get_node_marginal(circuit, var_indicator.first, marginals[var_indicator.first]);
+  }
+}
+
+} // end namespace {BN}
+
+#endif
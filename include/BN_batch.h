@@ -0,0 +1,239 @@
+#ifndef _BN_BATCH_H_
+#define _BN_BATCH_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <limits>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_factor_pool.h"
+#include "BN_variable_elimination.h"
+#include "util.h"
+
+namespace BN
+{
+
+// the batch axis is carried as an ordinary variable with this index and cardinality equal to the
+// number of evidence cases, batched factors always keep it as their first (innermost) variable so
+// that the product and sum-out runs are contiguous across the cases
+const UInt BATCH_VAR = std::numeric_limits<UInt>::max();
+
+
+bool is_batched(const factor& factor_elem)
+{
+  return (factor_elem.variables.empty() == false) && (factor_elem.variables[0] == BATCH_VAR);
+}
+
+
+void batch_factor_product(const factor& factor_left,
+                          const factor& factor_right,
+                                factor& product_result)
+{
+  // batched operand goes on the left so the batch axis stays first in the product
+  if ((is_batched(factor_left) == false) && (is_batched(factor_right) == true))
+  {  factor_product(factor_right, factor_left, product_result);  }
+  else
+  {  factor_product(factor_left, factor_right, product_result);  }
+}
+
+
+void make_batch_evidence(const std::vector<std::vector<UIntVec>>& evidence_batch,
+                         const std::vector<factor*>&              factor_vec,
+                               std::vector<factor>&               indicator_factors)
+{
+  // one indicator {BATCH_VAR, var} per observed variable, a case that doesn't observe
+  // the variable gets 1 for every state
+  const UInt batch_size = static_cast<UInt>(evidence_batch.size());
+
+  std::map<UInt, UInt> var_cardinals;
+  for (const factor* factor_ptr: factor_vec)
+  {
+    for (std::size_t iter = 0u; iter < factor_ptr->variables.size(); iter++)
+    {  var_cardinals[factor_ptr->variables[iter]] = factor_ptr->cardinals[iter];  }
+  }
+
+  std::set<UInt> observed_vars;
+  for (const std::vector<UIntVec>& evidence: evidence_batch)
+  {
+    for (const UIntVec& evidence_elem: evidence)
+    {
+      if (var_cardinals.find(evidence_elem[0]) != var_cardinals.end())
+      {  observed_vars.insert(evidence_elem[0]);  }
+    }
+  }
+
+  indicator_factors.clear();
+  for (const UInt var: observed_vars)
+  {
+    factor indicator;
+    indicator.variables = UIntVec{BATCH_VAR, var};
+    indicator.cardinals = UIntVec{batch_size, var_cardinals[var]};
+    indicator.values.assign(batch_size*var_cardinals[var], 1.0f);
+
+    for (UInt batch_iter = 0u; batch_iter < batch_size; batch_iter++)
+    {
+      for (const UIntVec& evidence_elem: evidence_batch[batch_iter])
+      {
+        if (   (evidence_elem[0] == var)
+            && (evidence_elem[1] <  var_cardinals[var]) )
+        {
+          for (UInt state = 0u; state < var_cardinals[var]; state++)
+          {
+            indicator.values[state*batch_size + batch_iter] = (state == evidence_elem[1]) ? 1.0f : 0.0f;
+          }
+        }
+      }
+    }
+    indicator_factors.push_back(std::move(indicator));
+  }
+}
+
+
+void batch_factor_normalize(factor& factor_to_normalize)
+{
+  // every case (batch index) is normalized on its own
+  if (is_batched(factor_to_normalize) == false)
+  {
+    factor_normalize(factor_to_normalize);
+    return;
+  }
+
+  const UInt batch_size = factor_to_normalize.cardinals[0];
+  const std::size_t num_rows = factor_to_normalize.values.size()/batch_size;
+  const simdKernels& kernels = active_simd_kernels();
+
+  std::vector<float> case_sums(batch_size, 0.0f);
+  for (std::size_t row = 0u; row < num_rows; row++)
+  {  kernels.add(&factor_to_normalize.values[row*batch_size], case_sums.data(), batch_size);  }
+
+  for (std::size_t row = 0u; row < num_rows; row++)
+  {
+    for (UInt batch_iter = 0u; batch_iter < batch_size; batch_iter++)
+    {  factor_to_normalize.values[row*batch_size + batch_iter] /= case_sums[batch_iter];  }
+  }
+}
+
+
+void get_batch_case(const factor& batched_factor,
+                    const UInt    batch_index,
+                          factor& case_factor)
+{
+  factor_reduce(batched_factor, std::vector<UIntVec>{ UIntVec{BATCH_VAR, batch_index} }, case_factor);
+}
+
+
+void compute_marginal_batch(const std::vector<UInt>&                 marginal_vars,
+                            const std::vector<std::vector<UIntVec>>& evidence_batch,
+                            const std::vector<factor*>&              factor_vec,
+                                  factor&                            batched_marginal,
+                            const elimination_heuristic              heuristic,
+                                  factorPool&                        pool,
+                                  elimination_stats&                 stats)
+{
+  // answers every evidence case in one elimination sweep, result is a factor over
+  // {BATCH_VAR, marginal_vars...} normalized per case
+  if ((factor_vec.empty() == true) || (evidence_batch.empty() == true))
+  {
+    std::cout << "Cannot compute batched marginal, given factor vector or evidence batch is empty";
+    return;
+  }
+
+  std::vector<factor> indicator_factors;
+  make_batch_evidence(evidence_batch, factor_vec, indicator_factors);
+
+  std::vector<factor*> factors;
+  factors.reserve(factor_vec.size() + indicator_factors.size());
+  for (const factor* factor_ptr: factor_vec)
+  {
+    factor& factor_copy = pool_acquire(pool);
+    factor_copy = *factor_ptr;
+    factors.push_back(&factor_copy);
+  }
+  for (factor& indicator: indicator_factors)
+  {
+    factor& indicator_copy = pool_acquire(pool);
+    std::swap(indicator_copy, indicator);
+    factors.push_back(&indicator_copy);
+  }
+
+  // the batch axis is never eliminated
+  std::set<UInt> all_vars;
+  for (const factor* factor_ptr: factors)
+  {  all_vars.insert(factor_ptr->variables.begin(), factor_ptr->variables.end());  }
+
+  UIntVec keep_vars(marginal_vars);
+  keep_vars.push_back(BATCH_VAR);
+  UIntVec vars_to_eliminate;
+  get_difference(UIntVec(all_vars.begin(), all_vars.end()), keep_vars, vars_to_eliminate);
+
+  get_elimination_order(factors, vars_to_eliminate, heuristic, stats);
+  for (const UInt var: stats.elimination_order)
+  {
+    eliminate_var(factors, var, pool, batch_factor_product);
+  }
+
+  // remaining factors only mention the query variables and the batch axis
+  factor* result = nullptr;
+  for (factor* factor_ptr: factors)
+  {
+    if (factor_ptr->variables.empty() == true)
+    {  continue;  }
+
+    if (result == nullptr)
+    {  result = factor_ptr;  }
+    else
+    {
+      factor& product_result = pool_acquire(pool);
+      batch_factor_product(*result, *factor_ptr, product_result);
+      result = &product_result;
+    }
+  }
+
+  batched_marginal.variables.clear();
+  batched_marginal.cardinals.clear();
+  batched_marginal.values.clear();
+  if (result != nullptr)
+  {  std::swap(batched_marginal, *result);  }
+  pool_release_all(pool);
+
+  // without any evidence the batch axis never enters, every case has the same answer
+  if (is_batched(batched_marginal) == false)
+  {
+    factor batch_axis;
+    batch_axis.variables = UIntVec{BATCH_VAR};
+    batch_axis.cardinals = UIntVec{static_cast<UInt>(evidence_batch.size())};
+    batch_axis.values.assign(evidence_batch.size(), 1.0f);
+
+    factor temp;
+    factor_product(batch_axis, batched_marginal, temp);
+    std::swap(batched_marginal, temp);
+  }
+
+  batch_factor_normalize(batched_marginal);
+}
+
+
+void compute_marginal_batch(const std::vector<UInt>&                 marginal_vars,
+                            const std::vector<std::vector<UIntVec>>& evidence_batch,
+                            const std::vector<factor*>&              factor_vec,
+                                  std::vector<factor>&               marginals)
+{
+  factorPool        pool;
+  elimination_stats stats;
+  factor            batched_marginal;
+  compute_marginal_batch(marginal_vars, evidence_batch, factor_vec, batched_marginal, MIN_FILL, pool, stats);
+
+  marginals.resize(evidence_batch.size());
+  if (is_batched(batched_marginal) == false)
+  {  return;  }
+
+  for (UInt batch_iter = 0u; batch_iter < evidence_batch.size(); batch_iter++)
+  {  get_batch_case(batched_marginal, batch_iter, marginals[batch_iter]);  }
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef _BN_CUTSET_CONDITIONING_H_
+#define _BN_CUTSET_CONDITIONING_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <limits>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_factor_pool.h"
+#include "BN_variable_elimination.h"
+#include "BN_parallel.h"
+#include "util.h"
+
+namespace BN
+{
+
+// instantiations are summed in this many contiguous blocks, whatever the number of threads
+const std::size_t CUTSET_NUM_BLOCKS = 256u;
+
+
+struct cutsetStats
+{
+  UIntVec cutset;
+  unsigned long long num_instantiations = 0u;
+
+  // of the network left after conditioning on the cutset, 1 or less for a polytree of pairwise factors
+  unsigned int induced_width = 0u;
+};
+
+
+void find_loop_cutset(const std::vector<factor*>& factor_vec,
+                      const std::vector<UIntVec>& evidence,
+                      const UIntVec&              keep_vars,
+                            UIntVec&              cutset)
+{
+  // greedy loop cutset of the factor graph (variables and factors as nodes, observed variables removed).
+  // leaves are pruned until only loops are left, then the variable in most of the remaining factors
+  // joins the cutset (keep_vars never do) and pruning goes on, until the graph is a forest
+  cutset.clear();
+  std::map<UInt, std::set<UInt>> var_factors;
+  std::vector<std::set<UInt>>    factor_vars(factor_vec.size());
+  for (UInt factor_id = 0u; factor_id < factor_vec.size(); factor_id++)
+  {
+    for (const UInt var: factor_vec[factor_id]->variables)
+    {
+      bool is_observed = false;
+      for (const UIntVec& evidence_elem: evidence)
+      {
+        if (evidence_elem[0] == var)
+        {
+          is_observed = true;
+          break;
+        }
+      }
+      if (is_observed == false)
+      {
+        var_factors[var].insert(factor_id);
+        factor_vars[factor_id].insert(var);
+      }
+    }
+  }
+
+  std::set<UInt> remaining_factors;
+  for (UInt factor_id = 0u; factor_id < factor_vars.size(); factor_id++)
+  {  remaining_factors.insert(factor_id);  }
+
+  auto remove_var = [&](const UInt var)
+  {
+    for (const UInt factor_id: var_factors[var])
+    {  factor_vars[factor_id].erase(var);  }
+    var_factors.erase(var);
+  };
+
+  while (true)
+  {
+    bool is_pruned = true;
+    while (is_pruned == true)
+    {
+      is_pruned = false;
+      for (std::map<UInt, std::set<UInt>>::iterator var = var_factors.begin(); var != var_factors.end(); )
+      {
+        if (var->second.size() <= 1u)
+        {
+          const UInt var_to_remove = var->first;
+          var++;
+          remove_var(var_to_remove);
+          is_pruned = true;
+        }
+        else
+        {  var++;  }
+      }
+      for (std::set<UInt>::iterator factor_id = remaining_factors.begin(); factor_id != remaining_factors.end(); )
+      {
+        if (factor_vars[*factor_id].size() <= 1u)
+        {
+          for (const UInt var: factor_vars[*factor_id])
+          {  var_factors[var].erase(*factor_id);  }
+          factor_vars[*factor_id].clear();
+          factor_id = remaining_factors.erase(factor_id);
+          is_pruned = true;
+        }
+        else
+        {  factor_id++;  }
+      }
+    }
+
+    // every loop has at least two variables, with one query variable there is always a candidate
+    UInt best_var = 0u;
+    std::size_t best_degree = 0u;
+    for (const std::pair<const UInt, std::set<UInt>>& var: var_factors)
+    {
+      if (   (var.second.size() > best_degree)
+          && (std::find(keep_vars.begin(), keep_vars.end(), var.first) == keep_vars.end()) )
+      {
+        best_degree = var.second.size();
+        best_var    = var.first;
+      }
+    }
+    if (best_degree == 0u)
+    {  break;  }
+
+    cutset.push_back(best_var);
+    remove_var(best_var);
+  }
+}
+
+
+void compute_marginal_cutset(const UInt                  marginal_var,
+                             const std::vector<UIntVec>& evidence,
+                             const std::vector<factor*>& factor_vec,
+                                   Eigen::ThreadPool&    pool,
+                                   factor&               factor_marg,
+                                   cutsetStats&          stats)
+{
+  // P(marginal_var | evidence) is proportional to the sum over the cutset instantiations c of P(marginal_var, c, evidence).
+  // conditioned on c the network is a polytree, so every term is one pass of variable elimination along
+  // an order computed once. instantiations are summed in a fixed number of contiguous blocks spread over the pool,
+  // every chunk has its own factor pool as scratch space, and the block sums are added in block order
+  // so the result doesn't depend on the threads
+  factor_marg.variables.clear();
+  factor_marg.cardinals.clear();
+  factor_marg.values.clear();
+  stats = cutsetStats();
+
+  std::map<UInt, UInt> var_cardinals;
+  for (const factor* factor_ptr: factor_vec)
+  {
+    for (std::size_t iter = 0u; iter < factor_ptr->variables.size(); iter++)
+    {  var_cardinals[factor_ptr->variables[iter]] = factor_ptr->cardinals[iter];  }
+  }
+  if (var_cardinals.find(marginal_var) == var_cardinals.end())
+  {
+    std::cout << "Cannot compute marginal, variable " << marginal_var << " is not in any factor\n";
+    return;
+  }
+
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    if (evidence_elem[0] == marginal_var)
+    {
+      add_observed_vars({marginal_var}, evidence, factor_vec, factor_marg);
+      return;
+    }
+  }
+
+  find_loop_cutset(factor_vec, evidence, UIntVec{marginal_var}, stats.cutset);
+  UIntVec cutset_cardinals;
+  std::size_t num_instantiations = 1u;
+  for (const UInt var: stats.cutset)
+  {
+    if (num_instantiations > std::numeric_limits<std::size_t>::max()/var_cardinals[var])
+    {
+      std::cout << "Cannot compute marginal, loop cutset of " << stats.cutset.size()
+                << " variables has too many instantiations\n";
+      return;
+    }
+    cutset_cardinals.push_back(var_cardinals[var]);
+    num_instantiations *= var_cardinals[var];
+  }
+  stats.num_instantiations = num_instantiations;
+
+  // scopes after conditioning are the same for every instantiation, so is the elimination order
+  std::vector<UIntVec> conditioned_evidence = evidence;
+  for (const UInt var: stats.cutset)
+  {  conditioned_evidence.push_back(UIntVec{var, 0u});  }
+
+  std::vector<factor> structure(factor_vec.size());
+  std::vector<factor*> structure_ptrs;
+  std::set<UInt> remaining_vars;
+  for (std::size_t iter = 0u; iter < factor_vec.size(); iter++)
+  {
+    factor_reduce(*factor_vec[iter], conditioned_evidence, structure[iter]);
+    structure_ptrs.push_back(&structure[iter]);
+    remaining_vars.insert(structure[iter].variables.begin(), structure[iter].variables.end());
+  }
+  UIntVec vars_to_eliminate;
+  get_difference(UIntVec(remaining_vars.begin(), remaining_vars.end()), UIntVec{marginal_var}, vars_to_eliminate);
+
+  elimination_stats order_stats;
+  get_elimination_order(structure_ptrs, vars_to_eliminate, MIN_FILL, order_stats);
+  stats.induced_width = order_stats.induced_width;
+
+  const UInt marginal_cardinal = var_cardinals[marginal_var];
+  const std::size_t num_cutset = stats.cutset.size();
+  const std::size_t num_blocks = std::min(num_instantiations, CUTSET_NUM_BLOCKS);
+  const std::size_t block_size = num_instantiations/num_blocks + ((num_instantiations % num_blocks != 0u) ? 1u : 0u);
+  std::vector<float> block_sums(num_blocks*marginal_cardinal, 0.0f);
+
+  run_chunks(pool, num_blocks, 1u, [&](const std::size_t begin, const std::size_t end)
+  {
+    factorPool scratch;
+    std::vector<UIntVec> instance_evidence = conditioned_evidence;
+    std::vector<factor*> factors;
+    factor temp;
+    const std::size_t instance_end = (end == num_blocks) ? num_instantiations : std::min(num_instantiations, end*block_size);
+    for (std::size_t instance = begin*block_size; instance < instance_end; instance++)
+    {
+      // cutset states of this instantiation, first cutset variable fastest
+      std::size_t remainder = instance;
+      for (std::size_t var_iter = 0u; var_iter < num_cutset; var_iter++)
+      {
+        instance_evidence[evidence.size() + var_iter][1] = static_cast<UInt>(remainder % cutset_cardinals[var_iter]);
+        remainder /= cutset_cardinals[var_iter];
+      }
+
+      factors.clear();
+      for (const factor* factor_ptr: factor_vec)
+      {
+        factor& reduced = pool_acquire(scratch);
+        factor_reduce(*factor_ptr, instance_evidence, reduced);
+        factors.push_back(&reduced);
+      }
+      for (const UInt var: order_stats.elimination_order)
+      {  eliminate_var(factors, var, scratch);  }
+
+      // constants carry the weight P(c, evidence), they can't go through factor_product which drops them
+      float weight = 1.0f;
+      factor* result = nullptr;
+      for (factor* factor_ptr: factors)
+      {
+        if (factor_ptr->variables.empty() == true)
+        {
+          if (factor_ptr->values.empty() == false)
+          {  weight *= factor_ptr->values[0];  }
+        }
+        else if (result == nullptr)
+        {  result = factor_ptr;  }
+        else
+        {
+          factor_product(*result, *factor_ptr, temp);
+          std::swap(*result, temp);
+        }
+      }
+
+      float* block_sum = &block_sums[(instance/block_size)*marginal_cardinal];
+      for (UInt state = 0u; state < marginal_cardinal; state++)
+      {  block_sum[state] += weight*((result == nullptr) ? 1.0f : result->values[state]);  }
+      pool_release_all(scratch);
+    }
+  });
+
+  factor_marg.variables = UIntVec{marginal_var};
+  factor_marg.cardinals = UIntVec{marginal_cardinal};
+  factor_marg.values.assign(marginal_cardinal, 0.0f);
+  for (std::size_t block = 0u; block < num_blocks; block++)
+  {
+    for (UInt state = 0u; state < marginal_cardinal; state++)
+    {  factor_marg.values[state] += block_sums[block*marginal_cardinal + state];  }
+  }
+  factor_normalize(factor_marg);
+}
+
+
+void compute_marginal_cutset(const UInt                  marginal_var,
+                             const std::vector<UIntVec>& evidence,
+                             const std::vector<factor*>& factor_vec,
+                                   Eigen::ThreadPool&    pool,
+                                   factor&               factor_marg)
+{
+  cutsetStats stats;
+  compute_marginal_cutset(marginal_var, evidence, factor_vec, pool, factor_marg, stats);
+}
+
+} // end namespace {BN}
+
+#endif
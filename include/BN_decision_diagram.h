@@ -0,0 +1,512 @@
+#ifndef _BN_DECISION_DIAGRAM_H_
+#define _BN_DECISION_DIAGRAM_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <limits>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_variable_elimination.h"
+#include "util.h"
+
+namespace BN
+{
+
+// variable of terminal nodes, larger than any variable so terminals sit below every decision
+const UInt ADD_TERMINAL_VAR = std::numeric_limits<UInt>::max();
+
+enum add_operation
+{
+  ADD_MULTIPLY = 0,
+  ADD_SUM      = 1
+};
+
+
+struct addNode
+{
+  // decision variable (ADD_TERMINAL_VAR for terminals), variables are ordered by their index
+  UInt var;
+
+  // first child in addManager::children, one child per state of var
+  UInt children_begin;
+
+  // value of terminal nodes
+  float value;
+};
+
+
+struct addKeyHash
+{
+  std::size_t operator()(const UIntVec& key) const
+  {
+    std::size_t result = key.size();
+    for (const UInt elem: key)
+    {  result ^= elem + 0x9e3779b9u + (result << 6) + (result >> 2);  }
+    return result;
+  }
+};
+
+
+struct addManager
+{
+  // every node of every diagram, nodes are never modified once created so diagrams share sub-graphs
+  std::vector<addNode> nodes;
+  UIntVec              children;
+
+  // unique tables, a node {var, children...} or a terminal value exists at most once
+  std::unordered_map<UIntVec, UInt, addKeyHash> unique_nodes;
+  std::map<float, UInt>                         unique_terminals;
+
+  std::map<UInt, UInt> var_cardinals;
+
+  // results of apply, keyed by both operand nodes, valid for the life time of the manager
+  std::unordered_map<unsigned long long, UInt> apply_cache[2];
+};
+
+
+// factor whose table is a diagram in the manager
+struct addFactor
+{
+  UIntVec variables;
+  UIntVec cardinals;
+  UInt    root = 0u;
+};
+
+
+UInt make_add_terminal(addManager& manager,
+                       const float value)
+{
+  // -0 and 0 are the same terminal
+  const float key = (value == 0.0f) ? 0.0f : value;
+  std::map<float, UInt>::const_iterator terminal = manager.unique_terminals.find(key);
+  if (terminal != manager.unique_terminals.end())
+  {  return terminal->second;  }
+
+  manager.nodes.push_back(addNode{ADD_TERMINAL_VAR, 0u, key});
+  const UInt node = static_cast<UInt>(manager.nodes.size() - 1u);
+  manager.unique_terminals[key] = node;
+  return node;
+}
+
+
+UInt make_add_node(addManager&    manager,
+                   const UInt     var,
+                   const UIntVec& node_children)
+{
+  // a decision whose branches are all the same node is redundant
+  if (std::all_of(node_children.begin(), node_children.end(),
+                  [&node_children](const UInt child) {  return child == node_children[0];  }))
+  {  return node_children[0];  }
+
+  UIntVec key(1u, var);
+  key.insert(key.end(), node_children.begin(), node_children.end());
+  std::unordered_map<UIntVec, UInt, addKeyHash>::const_iterator existing = manager.unique_nodes.find(key);
+  if (existing != manager.unique_nodes.end())
+  {  return existing->second;  }
+
+  manager.nodes.push_back(addNode{var, static_cast<UInt>(manager.children.size()), 0.0f});
+  manager.children.insert(manager.children.end(), node_children.begin(), node_children.end());
+  const UInt node = static_cast<UInt>(manager.nodes.size() - 1u);
+  manager.unique_nodes[key] = node;
+  return node;
+}
+
+
+UInt add_cofactor(const addManager& manager,
+                  const UInt        node,
+                  const UInt        var,
+                  const UInt        state)
+{
+  // node with var fixed to state, var must not be below node's variable
+  if (manager.nodes[node].var != var)
+  {  return node;  }
+  return manager.children[manager.nodes[node].children_begin + state];
+}
+
+
+UInt add_apply(addManager&         manager,
+               const add_operation operation,
+               const UInt          node1,
+               const UInt          node2)
+{
+  // copies, the node vector grows during the recursion
+  const addNode elem1 = manager.nodes[node1];
+  const addNode elem2 = manager.nodes[node2];
+  if ((elem1.var == ADD_TERMINAL_VAR) && (elem2.var == ADD_TERMINAL_VAR))
+  {
+    return make_add_terminal(manager, (operation == ADD_MULTIPLY) ? elem1.value*elem2.value
+                                                                   : elem1.value + elem2.value);
+  }
+
+  // zero annihilates products, so a zero region of either operand is never expanded
+  if (operation == ADD_MULTIPLY)
+  {
+    if (((elem1.var == ADD_TERMINAL_VAR) && (elem1.value == 0.0f)) || ((elem2.var == ADD_TERMINAL_VAR) && (elem2.value == 1.0f)))
+    {  return node1;  }
+    if (((elem2.var == ADD_TERMINAL_VAR) && (elem2.value == 0.0f)) || ((elem1.var == ADD_TERMINAL_VAR) && (elem1.value == 1.0f)))
+    {  return node2;  }
+  }
+
+  // both operations commute, operands are ordered for the cache
+  const unsigned long long cache_key = (static_cast<unsigned long long>(std::min(node1, node2)) << 32u) | std::max(node1, node2);
+  std::unordered_map<unsigned long long, UInt>::const_iterator cached = manager.apply_cache[operation].find(cache_key);
+  if (cached != manager.apply_cache[operation].end())
+  {  return cached->second;  }
+
+  const UInt top_var  = std::min(elem1.var, elem2.var);
+  const UInt cardinal = manager.var_cardinals[top_var];
+  UIntVec node_children(cardinal);
+  for (UInt state = 0u; state < cardinal; state++)
+  {
+    node_children[state] = add_apply(manager, operation,
+                                     add_cofactor(manager, node1, top_var, state),
+                                     add_cofactor(manager, node2, top_var, state));
+  }
+  const UInt result = make_add_node(manager, top_var, node_children);
+  manager.apply_cache[operation][cache_key] = result;
+  return result;
+}
+
+
+UInt add_sum_out_var(addManager&                    manager,
+                     const UInt                     node,
+                     const UInt                     var,
+                     std::unordered_map<UInt, UInt>& visited)
+{
+  // var is summed out below node, a branch that doesn't test var counts cardinality times
+  std::unordered_map<UInt, UInt>::const_iterator cached = visited.find(node);
+  if (cached != visited.end())
+  {  return cached->second;  }
+
+  const addNode elem = manager.nodes[node];
+  UInt result;
+  if (elem.var > var)
+  {
+    result = add_apply(manager, ADD_MULTIPLY, node, make_add_terminal(manager, static_cast<float>(manager.var_cardinals[var])));
+  }
+  else if (elem.var == var)
+  {
+    result = manager.children[elem.children_begin];
+    for (UInt state = 1u; state < manager.var_cardinals[var]; state++)
+    {  result = add_apply(manager, ADD_SUM, result, manager.children[elem.children_begin + state]);  }
+  }
+  else
+  {
+    UIntVec node_children(manager.var_cardinals[elem.var]);
+    for (UInt state = 0u; state < node_children.size(); state++)
+    {  node_children[state] = add_sum_out_var(manager, manager.children[elem.children_begin + state], var, visited);  }
+    result = make_add_node(manager, elem.var, node_children);
+  }
+  visited[node] = result;
+  return result;
+}
+
+
+UInt add_restrict(addManager&                    manager,
+                  const UInt                     node,
+                  const UInt                     var,
+                  const UInt                     state,
+                  std::unordered_map<UInt, UInt>& visited)
+{
+  std::unordered_map<UInt, UInt>::const_iterator cached = visited.find(node);
+  if (cached != visited.end())
+  {  return cached->second;  }
+
+  const addNode elem = manager.nodes[node];
+  UInt result = node;
+  if (elem.var == var)
+  {
+    result = manager.children[elem.children_begin + state];
+  }
+  else if (elem.var < var)
+  {
+    UIntVec node_children(manager.var_cardinals[elem.var]);
+    for (UInt child_state = 0u; child_state < node_children.size(); child_state++)
+    {  node_children[child_state] = add_restrict(manager, manager.children[elem.children_begin + child_state], var, state, visited);  }
+    result = make_add_node(manager, elem.var, node_children);
+  }
+  visited[node] = result;
+  return result;
+}
+
+
+UInt add_from_table(addManager&    manager,
+                    const factor&  source,
+                    const UIntVec& sorted_var_indices,
+                    const UIntVec& strides,
+                    const std::size_t level,
+                    const UInt     base_index)
+{
+  if (level == sorted_var_indices.size())
+  {  return make_add_terminal(manager, source.values[base_index]);  }
+
+  const UInt var_index = sorted_var_indices[level];
+  UIntVec node_children(source.cardinals[var_index]);
+  for (UInt state = 0u; state < source.cardinals[var_index]; state++)
+  {
+    node_children[state] = add_from_table(manager, source, sorted_var_indices, strides, level + 1u,
+                                          base_index + state*strides[var_index]);
+  }
+  return make_add_node(manager, source.variables[var_index], node_children);
+}
+
+
+void to_add_factor(const factor&     source,
+                         addManager& manager,
+                         addFactor&  dest)
+{
+  // table is split on its variables in diagram order, repeated blocks collapse into shared nodes
+  for (std::size_t iter = 0u; iter < source.variables.size(); iter++)
+  {  manager.var_cardinals[source.variables[iter]] = source.cardinals[iter];  }
+
+  UIntVec sorted_var_indices(source.variables.size());
+  for (std::size_t iter = 0u; iter < sorted_var_indices.size(); iter++)
+  {  sorted_var_indices[iter] = static_cast<UInt>(iter);  }
+  std::sort(sorted_var_indices.begin(), sorted_var_indices.end(),
+            [&source](const UInt index1, const UInt index2) {  return source.variables[index1] < source.variables[index2];  });
+
+  UIntVec strides;
+  get_strides(source, strides);
+
+  dest.variables = source.variables;
+  dest.cardinals = source.cardinals;
+  dest.root = source.values.empty() ? make_add_terminal(manager, 0.0f)
+                                    : add_from_table(manager, source, sorted_var_indices, strides, 0u, 0u);
+}
+
+
+void to_factor(const addManager& manager,
+               const addFactor&  source,
+                     factor&     dest)
+{
+  dest.variables = source.variables;
+  dest.cardinals = source.cardinals;
+  dest.values.resize(util::vec_prod(source.cardinals));
+
+  UIntVec assignment(source.variables.size(), 0u);
+  for (std::size_t iter = 0u; iter < dest.values.size(); iter++)
+  {
+    UInt node = source.root;
+    while (manager.nodes[node].var != ADD_TERMINAL_VAR)
+    {
+      const UInt var_index = static_cast<UInt>(std::find(source.variables.begin(), source.variables.end(), manager.nodes[node].var)
+                                               - source.variables.begin());
+      node = manager.children[manager.nodes[node].children_begin + assignment[var_index]];
+    }
+    dest.values[iter] = manager.nodes[node].value;
+
+    for (std::size_t var_iter = 0u; var_iter < assignment.size(); var_iter++)
+    {
+      assignment[var_iter]++;
+      if (assignment[var_iter] < source.cardinals[var_iter])
+      {  break;  }
+      assignment[var_iter] = 0u;
+    }
+  }
+}
+
+
+std::size_t add_num_nodes(const addManager& manager,
+                          const UInt        root)
+{
+  // number of distinct nodes (terminals included) reachable from root
+  std::set<UInt> visited;
+  std::vector<UInt> to_visit(1u, root);
+  while (to_visit.empty() == false)
+  {
+    const UInt node = to_visit.back();
+    to_visit.pop_back();
+    if (visited.insert(node).second == false)
+    {  continue;  }
+
+    if (manager.nodes[node].var != ADD_TERMINAL_VAR)
+    {
+      for (UInt state = 0u; state < manager.var_cardinals.at(manager.nodes[node].var); state++)
+      {  to_visit.push_back(manager.children[manager.nodes[node].children_begin + state]);  }
+    }
+  }
+  return visited.size();
+}
+
+
+void add_factor_product(      addManager& manager,
+                        const addFactor&  factor_left,
+                        const addFactor&  factor_right,
+                              addFactor&  product_result)
+{
+  // scope is the left variables followed by the right-only ones, same as factor_product
+  UIntVec variables = factor_left.variables;
+  UIntVec cardinals = factor_left.cardinals;
+  for (std::size_t iter = 0u; iter < factor_right.variables.size(); iter++)
+  {
+    if (std::find(variables.begin(), variables.end(), factor_right.variables[iter]) == variables.end())
+    {
+      variables.push_back(factor_right.variables[iter]);
+      cardinals.push_back(factor_right.cardinals[iter]);
+    }
+  }
+  product_result.root      = add_apply(manager, ADD_MULTIPLY, factor_left.root, factor_right.root);
+  product_result.variables = variables;
+  product_result.cardinals = cardinals;
+}
+
+
+void add_factor_sum_out(      addManager& manager,
+                        const addFactor&  factor_to_sum,
+                        const UIntVec&    sum_out_vars,
+                              addFactor&  sum_result)
+{
+  UInt root = factor_to_sum.root;
+  UIntVec variables, cardinals;
+  for (std::size_t iter = 0u; iter < factor_to_sum.variables.size(); iter++)
+  {
+    if (std::find(sum_out_vars.begin(), sum_out_vars.end(), factor_to_sum.variables[iter]) == sum_out_vars.end())
+    {
+      variables.push_back(factor_to_sum.variables[iter]);
+      cardinals.push_back(factor_to_sum.cardinals[iter]);
+    }
+    else
+    {
+      std::unordered_map<UInt, UInt> visited;
+      root = add_sum_out_var(manager, root, factor_to_sum.variables[iter], visited);
+    }
+  }
+  sum_result.root      = root;
+  sum_result.variables = variables;
+  sum_result.cardinals = cardinals;
+}
+
+
+void add_factor_reduce(      addManager&           manager,
+                       const addFactor&            factor_to_reduce,
+                       const std::vector<UIntVec>& evidence,
+                             addFactor&            reduced_result)
+{
+  UInt root = factor_to_reduce.root;
+  UIntVec variables, cardinals;
+  for (std::size_t iter = 0u; iter < factor_to_reduce.variables.size(); iter++)
+  {
+    bool is_observed = false;
+    for (const UIntVec& evidence_elem: evidence)
+    {
+      if (   (evidence_elem[0] == factor_to_reduce.variables[iter])
+          && (evidence_elem[1] <  factor_to_reduce.cardinals[iter]) )
+      {
+        std::unordered_map<UInt, UInt> visited;
+        root = add_restrict(manager, root, evidence_elem[0], evidence_elem[1], visited);
+        is_observed = true;
+        break;
+      }
+    }
+    if (is_observed == false)
+    {
+      variables.push_back(factor_to_reduce.variables[iter]);
+      cardinals.push_back(factor_to_reduce.cardinals[iter]);
+    }
+  }
+  reduced_result.root      = root;
+  reduced_result.variables = variables;
+  reduced_result.cardinals = cardinals;
+}
+
+
+void compute_marginal_add(const std::vector<UInt>&     marginal_vars,
+                          const std::vector<UIntVec>&  evidence,
+                          const std::vector<factor*>&  factor_vec,
+                                factor&                factor_marg)
+{
+  // variable elimination with every table held as a decision diagram,
+  // cost follows the number of distinct sub-tables instead of the table sizes
+  if (factor_vec.empty() == true)
+  {
+    std::cout << "Cannot compute marginal, given factor vector is empty";
+    return;
+  }
+
+  addManager manager;
+  std::vector<addFactor> factors;
+  std::set<UInt> all_vars;
+  addFactor converted;
+  for (const factor* factor_ptr: factor_vec)
+  {
+    to_add_factor(*factor_ptr, manager, converted);
+    factors.push_back(addFactor());
+    add_factor_reduce(manager, converted, evidence, factors.back());
+    all_vars.insert(factors.back().variables.begin(), factors.back().variables.end());
+  }
+
+  UIntVec vars_to_eliminate;
+  get_difference(UIntVec(all_vars.begin(), all_vars.end()), marginal_vars, vars_to_eliminate);
+
+  std::vector<factor> reduced_scopes;
+  std::vector<factor*> reduced_ref_vec;
+  reduced_scopes.reserve(factors.size());
+  for (const addFactor& factor_elem: factors)
+  {
+    reduced_scopes.push_back(factor());
+    reduced_scopes.back().variables = factor_elem.variables;
+    reduced_scopes.back().cardinals = factor_elem.cardinals;
+    reduced_ref_vec.push_back(&reduced_scopes.back());
+  }
+  elimination_stats stats;
+  get_elimination_order(reduced_ref_vec, vars_to_eliminate, MIN_FILL, stats);
+
+  addFactor product;
+  for (const UInt var: stats.elimination_order)
+  {
+    bool has_product = false;
+    std::vector<addFactor> remaining;
+    for (const addFactor& factor_elem: factors)
+    {
+      if (std::find(factor_elem.variables.begin(), factor_elem.variables.end(), var) == factor_elem.variables.end())
+      {  remaining.push_back(factor_elem);  }
+      else if (has_product == false)
+      {
+        product     = factor_elem;
+        has_product = true;
+      }
+      else
+      {  add_factor_product(manager, product, factor_elem, product);  }
+    }
+    factors = std::move(remaining);
+
+    if (has_product == true)
+    {
+      factors.push_back(addFactor());
+      add_factor_sum_out(manager, product, UIntVec{var}, factors.back());
+    }
+  }
+
+  // remaining factors only mention the query variables, constants drop out in normalization
+  addFactor result;
+  bool has_result = false;
+  for (const addFactor& factor_elem: factors)
+  {
+    if (factor_elem.variables.empty() == true)
+    {  continue;  }
+
+    if (has_result == false)
+    {
+      result     = factor_elem;
+      has_result = true;
+    }
+    else
+    {  add_factor_product(manager, result, factor_elem, result);  }
+  }
+
+  factor_marg = factor();
+  if (has_result == true)
+  {  to_factor(manager, result, factor_marg);  }
+
+  add_observed_vars(marginal_vars, evidence, factor_vec, factor_marg);
+  factor_normalize(factor_marg);
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef _BN_FACTOR_EXPRESSION_H_
+#define _BN_FACTOR_EXPRESSION_H_
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "util.h"
+
+namespace BN
+{
+
+// lazy product of factors, f1 * f2 * f3 only collects the operands, nothing is multiplied
+// until the expression is evaluated (operands have to outlive the expression)
+struct productExpression
+{
+  std::vector<const factor*> operands;
+};
+
+
+// lazy sum_out(vars, f1 * f2 * ...), evaluated straight into the reduced table
+struct sumOutExpression
+{
+  UIntVec           sum_out_vars;
+  productExpression product;
+};
+
+
+productExpression operator*(const factor& factor_left,
+                            const factor& factor_right)
+{
+  productExpression product;
+  product.operands = {&factor_left, &factor_right};
+  return product;
+}
+
+
+productExpression operator*(      productExpression product,
+                            const factor&           factor_right)
+{
+  product.operands.push_back(&factor_right);
+  return product;
+}
+
+
+sumOutExpression sum_out(const UIntVec&          sum_out_vars,
+                         const productExpression& product)
+{
+  return sumOutExpression{sum_out_vars, product};
+}
+
+
+sumOutExpression sum_out(const UInt               sum_out_var,
+                         const productExpression& product)
+{
+  return sumOutExpression{UIntVec{sum_out_var}, product};
+}
+
+
+bool factor_product_sum_out(const std::vector<const factor*>& operands,
+                            const UIntVec&                    sum_out_vars,
+                                  factor&                     sum_result)
+{
+  // sum_out_vars summed out of the product of all operands without building the product table,
+  // each result cell accumulates the product over the assignments of the summed variables.
+  // result variables are the union of the operand variables (in order of appearance) minus sum_out_vars,
+  // returns false if the operands disagree on a cardinality
+  sum_result.variables.clear();
+  sum_result.cardinals.clear();
+
+  UIntVec summed_vars, summed_cardinals;
+  for (const factor* operand: operands)
+  {
+    for (std::size_t iter = 0u; iter < operand->variables.size(); iter++)
+    {
+      const UInt var = operand->variables[iter];
+      const bool is_summed = std::find(sum_out_vars.begin(), sum_out_vars.end(), var) != sum_out_vars.end();
+      UIntVec& scope_vars      = is_summed ? summed_vars      : sum_result.variables;
+      UIntVec& scope_cardinals = is_summed ? summed_cardinals : sum_result.cardinals;
+
+      UIntVec::const_iterator existing = std::find(scope_vars.begin(), scope_vars.end(), var);
+      if (existing == scope_vars.end())
+      {
+        scope_vars.push_back(var);
+        scope_cardinals.push_back(operand->cardinals[iter]);
+      }
+      else if (scope_cardinals[existing - scope_vars.begin()] != operand->cardinals[iter])
+      {
+        std::cout << "Cardinals don't match, couldn't perform factor product\n";
+        sum_result.variables.clear();
+        sum_result.cardinals.clear();
+        sum_result.values.clear();
+        return false;
+      }
+    }
+  }
+  sum_result.values.assign(util::vec_prod(sum_result.cardinals), 0.0f);
+
+  // operands without values (never filled) are skipped, as in factor_product
+  std::vector<const factor*> used_operands;
+  for (const factor* operand: operands)
+  {
+    if (operand->values.empty() == false)
+    {  used_operands.push_back(operand);  }
+  }
+  const std::size_t num_operands = used_operands.size();
+  if (num_operands == 0u)
+  {
+    sum_result.values.clear();
+    return true;
+  }
+
+  // offset of every operand for every assignment of the summed variables (first summed variable fastest),
+  // laid out [summed assignment][operand], computed once and reused for every result cell
+  const UInt num_summed = util::vec_prod(summed_cardinals);
+  std::vector<UInt> summed_offsets(static_cast<std::size_t>(num_summed)*num_operands, 0u);
+  std::vector<UIntVec> result_strides(num_operands);
+  for (std::size_t operand_iter = 0u; operand_iter < num_operands; operand_iter++)
+  {
+    UIntVec strides;
+    get_strides_in_scope(*used_operands[operand_iter], summed_vars, strides);
+    get_strides_in_scope(*used_operands[operand_iter], sum_result.variables, result_strides[operand_iter]);
+
+    UIntVec assignment(summed_vars.size(), 0u);
+    UInt offset = 0u;
+    for (UInt summed_iter = 0u; summed_iter < num_summed; summed_iter++)
+    {
+      summed_offsets[summed_iter*num_operands + operand_iter] = offset;
+      for (std::size_t var_iter = 0u; var_iter < summed_vars.size(); var_iter++)
+      {
+        assignment[var_iter]++;
+        if (assignment[var_iter] < summed_cardinals[var_iter])
+        {
+          offset += strides[var_iter];
+          break;
+        }
+        assignment[var_iter] = 0u;
+        offset -= (summed_cardinals[var_iter] - 1u)*strides[var_iter];
+      }
+    }
+  }
+
+  // result cells in order, operand base indices are advanced as an odometer
+  const std::size_t num_vars = sum_result.variables.size();
+  UIntVec assignment(num_vars, 0u);
+  std::vector<UInt> base(num_operands, 0u);
+  std::vector<const float*> operand_values(num_operands);
+  for (std::size_t operand_iter = 0u; operand_iter < num_operands; operand_iter++)
+  {  operand_values[operand_iter] = used_operands[operand_iter]->values.data();  }
+
+  for (std::size_t iter_result = 0u; iter_result < sum_result.values.size(); iter_result++)
+  {
+    float cell_sum = 0.0f;
+    const UInt* offsets = summed_offsets.data();
+    for (UInt summed_iter = 0u; summed_iter < num_summed; summed_iter++, offsets += num_operands)
+    {
+      float term = operand_values[0][base[0] + offsets[0]];
+      for (std::size_t operand_iter = 1u; operand_iter < num_operands; operand_iter++)
+      {  term *= operand_values[operand_iter][base[operand_iter] + offsets[operand_iter]];  }
+      cell_sum += term;
+    }
+    sum_result.values[iter_result] = cell_sum;
+
+    for (std::size_t var_iter = 0u; var_iter < num_vars; var_iter++)
+    {
+      assignment[var_iter]++;
+      if (assignment[var_iter] < sum_result.cardinals[var_iter])
+      {
+        for (std::size_t operand_iter = 0u; operand_iter < num_operands; operand_iter++)
+        {  base[operand_iter] += result_strides[operand_iter][var_iter];  }
+        break;
+      }
+      assignment[var_iter] = 0u;
+      for (std::size_t operand_iter = 0u; operand_iter < num_operands; operand_iter++)
+      {  base[operand_iter] -= (sum_result.cardinals[var_iter] - 1u)*result_strides[operand_iter][var_iter];  }
+    }
+  }
+  return true;
+}
+
+
+void evaluate(const sumOutExpression& expression,
+                    factor&           sum_result)
+{
+  factor_product_sum_out(expression.product.operands, expression.sum_out_vars, sum_result);
+}
+
+
+void evaluate(const productExpression& expression,
+                    factor&            product_result)
+{
+  // nothing summed out, the plain k-way product in a single pass
+  factor_product_sum_out(expression.operands, UIntVec(), product_result);
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef _BN_FACTOR_POOL_H_
+#define _BN_FACTOR_POOL_H_
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "BN_types.h"
+
+namespace BN
+{
+
+struct factorPoolStats
+{
+  // factors that had to be constructed because the free list was empty
+  std::size_t factors_created = 0u;
+
+  // acquires served from the free list (no new factor object)
+  std::size_t factors_reused  = 0u;
+
+  // released factors whose table or scope outgrew the capacity they were handed out with,
+  // each one is at least one heap allocation inside the factor operations
+  std::size_t table_growths   = 0u;
+
+  // largest number of factors in use at the same time
+  std::size_t peak_in_use     = 0u;
+};
+
+
+struct factorPool
+{
+  // owns every factor handed out, factors keep their table and scope capacity when
+  // released so that the next intermediate of similar size doesn't touch the heap
+  std::vector<std::unique_ptr<factor>> storage;
+
+  // per storage slot: in use flag and capacity at the time it was acquired
+  std::vector<bool>        in_use;
+  std::vector<std::size_t> acquired_capacity;
+
+  // slots that can be handed out again
+  std::vector<std::size_t> free_list;
+  std::size_t              num_in_use = 0u;
+
+  factorPoolStats stats;
+};
+
+
+std::size_t factor_capacity(const factor& factor_elem)
+{
+  return   factor_elem.values.capacity()
+         + factor_elem.variables.capacity()
+         + factor_elem.cardinals.capacity();
+}
+
+
+factor& pool_acquire(factorPool& pool)
+{
+  std::size_t slot;
+  if (pool.free_list.empty() == false)
+  {
+    slot = pool.free_list.back();
+    pool.free_list.pop_back();
+    pool.stats.factors_reused++;
+  }
+  else
+  {
+    slot = pool.storage.size();
+    pool.storage.push_back(std::unique_ptr<factor>(new factor()));
+    pool.in_use.push_back(false);
+    pool.acquired_capacity.push_back(0u);
+    pool.stats.factors_created++;
+  }
+
+  // contents are dropped, capacity is kept
+  factor& factor_elem = *pool.storage[slot];
+  factor_elem.variables.clear();
+  factor_elem.cardinals.clear();
+  factor_elem.values.clear();
+
+  pool.in_use[slot]            = true;
+  pool.acquired_capacity[slot] = factor_capacity(factor_elem);
+  pool.num_in_use++;
+  pool.stats.peak_in_use = std::max(pool.stats.peak_in_use, pool.num_in_use);
+  return factor_elem;
+}
+
+
+void pool_release_slot(factorPool&       pool,
+                       const std::size_t slot)
+{
+  if (factor_capacity(*pool.storage[slot]) > pool.acquired_capacity[slot])
+  {  pool.stats.table_growths++;  }
+
+  pool.in_use[slot] = false;
+  pool.free_list.push_back(slot);
+  pool.num_in_use--;
+}
+
+
+void pool_release(factorPool& pool,
+                  factor&     factor_elem)
+{
+  for (std::size_t slot = 0u; slot < pool.storage.size(); slot++)
+  {
+    if (pool.storage[slot].get() == &factor_elem)
+    {
+      if (pool.in_use[slot] == true)
+      {  pool_release_slot(pool, slot);  }
+      return;
+    }
+  }
+  std::cout << "given factor is not owned by this pool\n";
+}
+
+
+void pool_release_all(factorPool& pool)
+{
+  // every intermediate of a query is freed in one shot
+  for (std::size_t slot = 0u; slot < pool.storage.size(); slot++)
+  {
+    if (pool.in_use[slot] == true)
+    {  pool_release_slot(pool, slot);  }
+  }
+}
+
+
+void pool_clear(factorPool& pool)
+{
+  // gives the memory back to the heap, all factors from the pool become invalid
+  pool.storage.clear();
+  pool.in_use.clear();
+  pool.acquired_capacity.clear();
+  pool.free_list.clear();
+  pool.num_in_use = 0u;
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef _BN_FACTOR_STORE_H_
+#define _BN_FACTOR_STORE_H_
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #define BN_STORE_MMAP 1
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#else
+  #define BN_STORE_MMAP 0
+#endif
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "util.h"
+
+namespace BN
+{
+
+/*
+binary factor store, version 1 (native byte order, checked through the magic number)
+  header     64 bytes  magic, version, number of factors, offset of the directory, file size
+  directory  32 bytes per factor: number of variables, offset of the scope, offset and count of the values
+  scopes     per factor, the variables followed by the cardinals (UInt each)
+  values     per factor, float block starting on a 64 byte boundary
+*/
+const std::uint32_t FACTOR_STORE_MAGIC   = 0x53464e42u;  // "BNFS"
+const std::uint32_t FACTOR_STORE_VERSION = 1u;
+const std::uint64_t FACTOR_STORE_ALIGN   = 64u;
+
+
+struct factorStoreHeader
+{
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t num_factors;
+  std::uint32_t reserved;
+  std::uint64_t directory_offset;
+  std::uint64_t file_size;
+  std::uint8_t  padding[32];
+};
+
+
+struct factorStoreEntry
+{
+  std::uint32_t num_vars;
+  std::uint32_t reserved;
+  std::uint64_t scope_offset;
+  std::uint64_t values_offset;
+  std::uint64_t num_values;
+};
+
+
+// read-only factor pointing into the store, valid while the store is open
+struct factorView
+{
+  const UInt*  variables;
+  const UInt*  cardinals;
+  UInt         num_vars;
+  const float* values;
+  std::size_t  num_values;
+};
+
+
+struct factorStore
+{
+  const char* data = nullptr;
+  std::size_t size = 0u;
+
+  // set when the file is mapped, otherwise data points into buffer
+  bool is_mapped = false;
+  std::vector<std::uint64_t> buffer;
+
+  std::vector<factorView> factors;
+
+  factorStore() = default;
+  factorStore(const factorStore&) = delete;
+  factorStore& operator=(const factorStore&) = delete;
+  ~factorStore();
+};
+
+
+void close_factor_store(factorStore& store)
+{
+#if BN_STORE_MMAP
+  if (store.is_mapped == true)
+  {  munmap(const_cast<char*>(store.data), store.size);  }
+#endif
+  store.data      = nullptr;
+  store.size      = 0u;
+  store.is_mapped = false;
+  store.buffer.clear();
+  store.factors.clear();
+}
+
+
+inline factorStore::~factorStore()
+{
+  close_factor_store(*this);
+}
+
+
+std::uint64_t align_store_offset(const std::uint64_t offset)
+{
+  return (offset + FACTOR_STORE_ALIGN - 1u)/FACTOR_STORE_ALIGN*FACTOR_STORE_ALIGN;
+}
+
+
+bool write_factor_store(const std::string&          file_path,
+                        const std::vector<factor*>& factor_vec)
+{
+  // offsets are laid out first, then everything is written in one sequential pass
+  factorStoreHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic            = FACTOR_STORE_MAGIC;
+  header.version          = FACTOR_STORE_VERSION;
+  header.num_factors      = static_cast<std::uint32_t>(factor_vec.size());
+  header.directory_offset = sizeof(factorStoreHeader);
+
+  std::vector<factorStoreEntry> directory(factor_vec.size());
+  std::uint64_t offset = header.directory_offset + directory.size()*sizeof(factorStoreEntry);
+  for (std::size_t iter = 0u; iter < factor_vec.size(); iter++)
+  {
+    if (   (factor_vec[iter]->variables.size() != factor_vec[iter]->cardinals.size())
+        || (factor_vec[iter]->values.size()    != util::vec_prod(factor_vec[iter]->cardinals)) )
+    {
+      std::cout << "factor " << iter << " has an inconsistent scope, couldn't write factor store\n";
+      return false;
+    }
+    std::memset(&directory[iter], 0, sizeof(factorStoreEntry));
+    directory[iter].num_vars     = static_cast<std::uint32_t>(factor_vec[iter]->variables.size());
+    directory[iter].scope_offset = offset;
+    offset += 2u*directory[iter].num_vars*sizeof(UInt);
+  }
+  for (std::size_t iter = 0u; iter < factor_vec.size(); iter++)
+  {
+    offset = align_store_offset(offset);
+    directory[iter].values_offset = offset;
+    directory[iter].num_values    = factor_vec[iter]->values.size();
+    offset += directory[iter].num_values*sizeof(float);
+  }
+  header.file_size = offset;
+
+  std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+  if (file.is_open() == false)
+  {
+    std::cout << "couldn't open " << file_path << " for writing\n";
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(directory.data()), directory.size()*sizeof(factorStoreEntry));
+  for (const factor* factor_ptr: factor_vec)
+  {
+    file.write(reinterpret_cast<const char*>(factor_ptr->variables.data()), factor_ptr->variables.size()*sizeof(UInt));
+    file.write(reinterpret_cast<const char*>(factor_ptr->cardinals.data()), factor_ptr->cardinals.size()*sizeof(UInt));
+  }
+
+  const char zeros[FACTOR_STORE_ALIGN] = {};
+  for (std::size_t iter = 0u; iter < factor_vec.size(); iter++)
+  {
+    const std::uint64_t position = static_cast<std::uint64_t>(file.tellp());
+    file.write(zeros, static_cast<std::streamsize>(directory[iter].values_offset - position));
+    file.write(reinterpret_cast<const char*>(factor_vec[iter]->values.data()), factor_vec[iter]->values.size()*sizeof(float));
+  }
+
+  if (file.good() == false)
+  {
+    std::cout << "couldn't write factor store " << file_path << '\n';
+    return false;
+  }
+  return true;
+}
+
+
+bool map_store_file(const std::string& file_path,
+                          factorStore& store)
+{
+#if BN_STORE_MMAP
+  const int file_descriptor = open(file_path.c_str(), O_RDONLY);
+  if (file_descriptor == -1)
+  {  return false;  }
+
+  struct stat file_stat;
+  if ((fstat(file_descriptor, &file_stat) != 0) || (file_stat.st_size <= 0))
+  {
+    close(file_descriptor);
+    return false;
+  }
+
+  void* mapping = mmap(nullptr, static_cast<std::size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+  close(file_descriptor);
+  if (mapping == MAP_FAILED)
+  {  return false;  }
+
+  store.data      = static_cast<const char*>(mapping);
+  store.size      = static_cast<std::size_t>(file_stat.st_size);
+  store.is_mapped = true;
+  return true;
+#else
+  // no mmap, the file is read into a 64 bit aligned buffer instead
+  std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+  if (file.is_open() == false)
+  {  return false;  }
+
+  store.size = static_cast<std::size_t>(file.tellg());
+  store.buffer.resize((store.size + sizeof(std::uint64_t) - 1u)/sizeof(std::uint64_t));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(store.buffer.data()), static_cast<std::streamsize>(store.size));
+  store.data = reinterpret_cast<const char*>(store.buffer.data());
+  return file.good();
+#endif
+}
+
+
+bool store_range_is_valid(const std::uint64_t store_size,
+                          const std::uint64_t offset,
+                          const std::uint64_t count,
+                          const std::uint64_t elem_size)
+{
+  // offset and length are checked separately, so a crafted offset or count can't wrap the sum
+  return (offset <= store_size) && (count <= (store_size - offset)/elem_size);
+}
+
+
+bool open_factor_store(const std::string& file_path,
+                             factorStore& store)
+{
+  // factors are views into the file, nothing is parsed or copied per factor
+  close_factor_store(store);
+  if (map_store_file(file_path, store) == false)
+  {
+    std::cout << "couldn't open factor store " << file_path << '\n';
+    return false;
+  }
+
+  factorStoreHeader header;
+  if (store.size >= sizeof(header))
+  {  std::memcpy(&header, store.data, sizeof(header));  }
+
+  if (   (store.size < sizeof(header))
+      || (header.magic   != FACTOR_STORE_MAGIC)
+      || (header.version != FACTOR_STORE_VERSION)
+      || (header.file_size != store.size)
+      || (header.directory_offset % alignof(factorStoreEntry) != 0u)
+      || (store_range_is_valid(store.size, header.directory_offset, header.num_factors, sizeof(factorStoreEntry)) == false) )
+  {
+    std::cout << file_path << " is not a version " << FACTOR_STORE_VERSION << " factor store\n";
+    close_factor_store(store);
+    return false;
+  }
+
+  const factorStoreEntry* directory = reinterpret_cast<const factorStoreEntry*>(store.data + header.directory_offset);
+  store.factors.resize(header.num_factors);
+  for (std::uint32_t iter = 0u; iter < header.num_factors; iter++)
+  {
+    const factorStoreEntry& entry = directory[iter];
+    if (   (entry.scope_offset  % alignof(UInt) != 0u)
+        || (store_range_is_valid(store.size, entry.scope_offset, 2u*static_cast<std::uint64_t>(entry.num_vars), sizeof(UInt)) == false)
+        || (entry.values_offset % FACTOR_STORE_ALIGN != 0u)
+        || (store_range_is_valid(store.size, entry.values_offset, entry.num_values, sizeof(float)) == false) )
+    {
+      std::cout << "factor " << iter << " in " << file_path << " is out of bounds\n";
+      close_factor_store(store);
+      return false;
+    }
+
+    // the value count has to be exactly what the stored scope addresses
+    const UInt* variables = reinterpret_cast<const UInt*>(store.data + entry.scope_offset);
+    const UInt* cardinals = variables + entry.num_vars;
+    std::uint64_t scope_size = 1u;
+    for (std::uint32_t var_iter = 0u; (var_iter < entry.num_vars) && (scope_size <= entry.num_values); var_iter++)
+    {  scope_size *= cardinals[var_iter];  }
+    if (scope_size != entry.num_values)
+    {
+      std::cout << "factor " << iter << " in " << file_path << " has " << entry.num_values
+                << " values, which doesn't match its cardinals\n";
+      close_factor_store(store);
+      return false;
+    }
+
+    factorView& view = store.factors[iter];
+    view.num_vars   = entry.num_vars;
+    view.variables  = variables;
+    view.cardinals  = cardinals;
+    view.values     = reinterpret_cast<const float*>(store.data + entry.values_offset);
+    view.num_values = static_cast<std::size_t>(entry.num_values);
+  }
+  return true;
+}
+
+
+void to_factor(const factorView& view,
+                     factor&     dest)
+{
+  // owning copy, for the operations that take BN::factor
+  dest.variables.assign(view.variables, view.variables + view.num_vars);
+  dest.cardinals.assign(view.cardinals, view.cardinals + view.num_vars);
+  dest.values.assign(view.values, view.values + view.num_values);
+}
+
+
+std::ostream& operator<<(std::ostream& os,
+                         const factorView& factor_to_output)
+{
+  os << "vars:       ";
+  for (UInt iter = 0u; iter < factor_to_output.num_vars; iter++)         {  os << factor_to_output.variables[iter] << " ";  }
+  os << "\ncardinality: ";
+  for (UInt iter = 0u; iter < factor_to_output.num_vars; iter++)         {  os << factor_to_output.cardinals[iter] << " ";  }
+  os << "\nCpd:         ";
+  for (std::size_t iter = 0u; iter < factor_to_output.num_values; iter++) {  os << factor_to_output.values[iter] << " ";  }
+  os << '\n';
+  return os;
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,351 @@
+#ifndef _BN_GIBBS_H_
+#define _BN_GIBBS_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstdint>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_parallel.h"
+#include "BN_sampling.h"
+#include "util.h"
+
+namespace BN
+{
+
+// colors with fewer variables than this are resampled on the calling thread
+const std::size_t DEFAULT_MIN_PARALLEL_VARS = 256u;
+
+
+struct gibbsOptions
+{
+  UInt num_chains  = 4u;
+
+  // sweeps thrown away at the start of every chain, then num_samples kept, one every thinning sweeps
+  UInt burn_in     = 500u;
+  UInt num_samples = 2000u;
+  UInt thinning    = 1u;
+
+  std::uint64_t seed = 0u;
+
+  std::size_t min_parallel_vars = DEFAULT_MIN_PARALLEL_VARS;
+};
+
+
+// factors indexed by local variable ids, the factors of variable v are
+// var_factors[var_factor_offsets[v] .. var_factor_offsets[v+1]) with the position of v in each of them,
+// variables of color c are color_vars[color_offsets[c] .. color_offsets[c+1]), no two of them share a factor
+struct gibbsSampler
+{
+  std::vector<factor>  factors;
+  std::vector<UIntVec> factor_var_ids;
+  std::vector<UIntVec> factor_strides;
+
+  UIntVec              variables;
+  UIntVec              var_cardinals;
+  std::map<UInt, UInt> var_ids;
+
+  UIntVec var_factor_offsets;
+  UIntVec var_factors;
+  UIntVec var_factor_positions;
+
+  UIntVec color_offsets;
+  UIntVec color_vars;
+};
+
+
+void color_variables(gibbsSampler& sampler)
+{
+  // greedy coloring of the moral (interaction) graph, highest degree first (Welsh-Powell),
+  // every variable gets the smallest color none of its neighbours has
+  const UInt num_vars = static_cast<UInt>(sampler.variables.size());
+  std::vector<std::set<UInt>> neighbours(num_vars);
+  for (const UIntVec& var_ids: sampler.factor_var_ids)
+  {
+    for (const UInt var_id: var_ids)
+    {
+      for (const UInt other_id: var_ids)
+      {
+        if (other_id != var_id)
+        {  neighbours[var_id].insert(other_id);  }
+      }
+    }
+  }
+
+  UIntVec order(num_vars);
+  for (UInt var_id = 0u; var_id < num_vars; var_id++)
+  {  order[var_id] = var_id;  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&neighbours](const UInt left, const UInt right) {  return neighbours[left].size() > neighbours[right].size();  });
+
+  const UInt uncolored = static_cast<UInt>(-1);
+  UIntVec colors(num_vars, uncolored);
+  UInt num_colors = 0u;
+  std::vector<bool> is_taken;
+  for (const UInt var_id: order)
+  {
+    is_taken.assign(num_colors + 1u, false);
+    for (const UInt other_id: neighbours[var_id])
+    {
+      if (colors[other_id] != uncolored)
+      {  is_taken[colors[other_id]] = true;  }
+    }
+    UInt color = 0u;
+    while (is_taken[color] == true)
+    {  color++;  }
+    colors[var_id] = color;
+    num_colors = std::max(num_colors, color + 1u);
+  }
+
+  // counting sort of the variables by color
+  sampler.color_offsets.assign(num_colors + 1u, 0u);
+  for (const UInt color: colors)
+  {  sampler.color_offsets[color + 1u]++;  }
+  for (UInt color = 0u; color < num_colors; color++)
+  {  sampler.color_offsets[color + 1u] += sampler.color_offsets[color];  }
+
+  UIntVec fill(sampler.color_offsets.begin(), sampler.color_offsets.end() - 1);
+  sampler.color_vars.resize(num_vars);
+  for (UInt var_id = 0u; var_id < num_vars; var_id++)
+  {  sampler.color_vars[fill[colors[var_id]]++] = var_id;  }
+}
+
+
+void build_gibbs_sampler(const std::vector<factor*>& factor_vec,
+                               gibbsSampler&         sampler)
+{
+  // any factor set works (CPDs or potentials), constant factors are left out
+  sampler = gibbsSampler();
+  for (const factor* factor_ptr: factor_vec)
+  {
+    if (factor_ptr->variables.empty() == true)
+    {  continue;  }
+
+    sampler.factors.push_back(*factor_ptr);
+    UIntVec var_ids, strides;
+    for (std::size_t iter = 0u; iter < factor_ptr->variables.size(); iter++)
+    {
+      std::map<UInt, UInt>::const_iterator existing = sampler.var_ids.find(factor_ptr->variables[iter]);
+      if (existing == sampler.var_ids.end())
+      {
+        const UInt var_id = static_cast<UInt>(sampler.variables.size());
+        sampler.var_ids[factor_ptr->variables[iter]] = var_id;
+        sampler.variables.push_back(factor_ptr->variables[iter]);
+        sampler.var_cardinals.push_back(factor_ptr->cardinals[iter]);
+        var_ids.push_back(var_id);
+      }
+      else
+      {  var_ids.push_back(existing->second);  }
+    }
+    get_strides(*factor_ptr, strides);
+    sampler.factor_var_ids.push_back(std::move(var_ids));
+    sampler.factor_strides.push_back(std::move(strides));
+  }
+
+  // factors of every variable, counting sort by variable
+  const UInt num_vars = static_cast<UInt>(sampler.variables.size());
+  sampler.var_factor_offsets.assign(num_vars + 1u, 0u);
+  for (const UIntVec& var_ids: sampler.factor_var_ids)
+  {
+    for (const UInt var_id: var_ids)
+    {  sampler.var_factor_offsets[var_id + 1u]++;  }
+  }
+  for (UInt var_id = 0u; var_id < num_vars; var_id++)
+  {  sampler.var_factor_offsets[var_id + 1u] += sampler.var_factor_offsets[var_id];  }
+
+  UIntVec fill(sampler.var_factor_offsets.begin(), sampler.var_factor_offsets.end() - 1);
+  sampler.var_factors.resize(sampler.var_factor_offsets.back());
+  sampler.var_factor_positions.resize(sampler.var_factor_offsets.back());
+  for (UInt factor_id = 0u; factor_id < sampler.factor_var_ids.size(); factor_id++)
+  {
+    for (UInt position = 0u; position < sampler.factor_var_ids[factor_id].size(); position++)
+    {
+      const UInt slot = fill[sampler.factor_var_ids[factor_id][position]]++;
+      sampler.var_factors[slot]          = factor_id;
+      sampler.var_factor_positions[slot] = position;
+    }
+  }
+
+  color_variables(sampler);
+}
+
+
+float gibbs_uniform(const std::uint64_t seed,
+                    const UInt          var_id,
+                    const UInt          sweep,
+                    const UInt          chain)
+{
+  // one counter per (variable, sweep, chain), results don't depend on the update order or thread
+  const std::uint32_t counter[4] = {var_id, sweep, chain, 0u};
+  std::uint32_t random_words[4];
+  philox_4x32(counter, seed, random_words);
+  return static_cast<float>(random_words[0] >> 8)*(1.0f/16777216.0f);
+}
+
+
+void resample_variable(const gibbsSampler&       sampler,
+                       const UInt                var_id,
+                       const float               uniform,
+                             UIntVec&            states,
+                             std::vector<float>& conditional)
+{
+  // P(v | markov blanket) is proportional to the product of the factors of v at the current states
+  // of the other variables, a conditional of all zeros is drawn uniformly
+  const UInt cardinal = sampler.var_cardinals[var_id];
+  conditional.assign(cardinal, 1.0f);
+  for (UInt iter = sampler.var_factor_offsets[var_id]; iter < sampler.var_factor_offsets[var_id + 1u]; iter++)
+  {
+    const UInt     factor_id = sampler.var_factors[iter];
+    const UInt     position  = sampler.var_factor_positions[iter];
+    const UIntVec& var_ids   = sampler.factor_var_ids[factor_id];
+    const UIntVec& strides   = sampler.factor_strides[factor_id];
+
+    UInt base = 0u;
+    for (std::size_t var_iter = 0u; var_iter < var_ids.size(); var_iter++)
+    {
+      if (var_iter != position)
+      {  base += states[var_ids[var_iter]]*strides[var_iter];  }
+    }
+    const float* values = &sampler.factors[factor_id].values[base];
+    for (UInt state = 0u; state < cardinal; state++)
+    {  conditional[state] *= values[state*strides[position]];  }
+  }
+
+  float total = 0.0f;
+  for (const float value: conditional)
+  {  total += value;  }
+  if (total <= 0.0f)
+  {
+    states[var_id] = std::min(static_cast<UInt>(uniform*cardinal), cardinal - 1u);
+    return;
+  }
+
+  const float target = uniform*total;
+  float cumulative = 0.0f;
+  UInt state = 0u;
+  for (; state + 1u < cardinal; state++)
+  {
+    cumulative += conditional[state];
+    if (target < cumulative)
+    {  break;  }
+  }
+  states[var_id] = state;
+}
+
+
+void run_gibbs_chain(const gibbsSampler&              sampler,
+                     const std::vector<int>&          observed_states,
+                     const gibbsOptions&              options,
+                     const UInt                       chain,
+                           Eigen::ThreadPool*         pool,
+                           std::vector<std::uint64_t>& counts,
+                     const UIntVec&                   count_offsets)
+{
+  // one sweep resamples the colors in turn, variables of one color don't share a factor,
+  // so they are resampled concurrently without locks
+  const UInt num_vars = static_cast<UInt>(sampler.variables.size());
+  UIntVec states(num_vars);
+  for (UInt var_id = 0u; var_id < num_vars; var_id++)
+  {
+    if (observed_states[var_id] != -1)
+    {  states[var_id] = static_cast<UInt>(observed_states[var_id]);  }
+    else
+    {
+      const float uniform = gibbs_uniform(options.seed, var_id, 0u, chain);
+      states[var_id] = std::min(static_cast<UInt>(uniform*sampler.var_cardinals[var_id]), sampler.var_cardinals[var_id] - 1u);
+    }
+  }
+
+  const UInt thinning   = std::max(1u, options.thinning);
+  const UInt num_sweeps = options.burn_in + options.num_samples*thinning;
+  for (UInt sweep = 1u; sweep <= num_sweeps; sweep++)
+  {
+    for (UInt color = 0u; color + 1u < sampler.color_offsets.size(); color++)
+    {
+      const UInt color_begin = sampler.color_offsets[color];
+      const std::size_t color_size = sampler.color_offsets[color + 1u] - color_begin;
+      auto resample_range = [&](const std::size_t begin, const std::size_t end)
+      {
+        std::vector<float> conditional;
+        for (std::size_t iter = begin; iter < end; iter++)
+        {
+          const UInt var_id = sampler.color_vars[color_begin + iter];
+          if (observed_states[var_id] == -1)
+          {  resample_variable(sampler, var_id, gibbs_uniform(options.seed, var_id, sweep, chain), states, conditional);  }
+        }
+      };
+
+      if ((pool != nullptr) && (color_size >= options.min_parallel_vars))
+      {  run_chunks(*pool, color_size, 1u, resample_range);  }
+      else
+      {  resample_range(0u, color_size);  }
+    }
+
+    if ((sweep > options.burn_in) && ((sweep - options.burn_in) % thinning == 0u))
+    {
+      for (UInt var_id = 0u; var_id < num_vars; var_id++)
+      {  counts[count_offsets[var_id] + states[var_id]]++;  }
+    }
+  }
+}
+
+
+void compute_all_marginals(const std::vector<UIntVec>&   evidence,
+                           const gibbsSampler&           sampler,
+                           const gibbsOptions&           options,
+                                 Eigen::ThreadPool&      pool,
+                                 std::map<UInt, factor>& marginals)
+{
+  // with several chains every chain runs on its own pool thread, a single chain spreads each color
+  // over the pool instead. state counts are integers, so the estimate is the same for any thread count
+  const UInt num_vars = static_cast<UInt>(sampler.variables.size());
+  std::vector<int> observed_states(num_vars, -1);
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    std::map<UInt, UInt>::const_iterator var = sampler.var_ids.find(evidence_elem[0]);
+    if ((var != sampler.var_ids.end()) && (evidence_elem[1] < sampler.var_cardinals[var->second]))
+    {  observed_states[var->second] = static_cast<int>(evidence_elem[1]);  }
+  }
+
+  UIntVec count_offsets(num_vars + 1u, 0u);
+  for (UInt var_id = 0u; var_id < num_vars; var_id++)
+  {  count_offsets[var_id + 1u] = count_offsets[var_id] + sampler.var_cardinals[var_id];  }
+
+  const UInt num_chains = std::max(1u, options.num_chains);
+  std::vector<std::vector<std::uint64_t>> chain_counts(num_chains, std::vector<std::uint64_t>(count_offsets.back(), 0u));
+  if (num_chains > 1u)
+  {
+    run_chunks(pool, num_chains, 1u, [&](const std::size_t begin, const std::size_t end)
+    {
+      for (std::size_t chain = begin; chain < end; chain++)
+      {  run_gibbs_chain(sampler, observed_states, options, static_cast<UInt>(chain), nullptr, chain_counts[chain], count_offsets);  }
+    });
+  }
+  else
+  {  run_gibbs_chain(sampler, observed_states, options, 0u, &pool, chain_counts[0], count_offsets);  }
+
+  marginals.clear();
+  for (UInt var_id = 0u; var_id < num_vars; var_id++)
+  {
+    factor& marginal = marginals[sampler.variables[var_id]];
+    marginal.variables = UIntVec{sampler.variables[var_id]};
+    marginal.cardinals = UIntVec{sampler.var_cardinals[var_id]};
+    marginal.values.assign(sampler.var_cardinals[var_id], 0.0f);
+    for (UInt state = 0u; state < sampler.var_cardinals[var_id]; state++)
+    {
+      std::uint64_t count = 0u;
+      for (UInt chain = 0u; chain < num_chains; chain++)
+      {  count += chain_counts[chain][count_offsets[var_id] + state];  }
+      marginal.values[state] = static_cast<float>(count);
+    }
+    factor_normalize(marginal);
+  }
+}
+
+} // end namespace {BN}
+
+#endif
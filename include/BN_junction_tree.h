@@ -0,0 +1,334 @@
+#ifndef _BN_JUNCTION_TREE_H_
+#define _BN_JUNCTION_TREE_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_variable_elimination.h"
+#include "util.h"
+
+namespace BN
+{
+
+struct junctionTree
+{
+  // variables of each clique
+  std::vector<UIntVec> cliques;
+
+  // product of the factors assigned to each clique, over the full clique scope (no evidence)
+  std::vector<factor> clique_potentials;
+
+  // tree edges {clique1, clique2} and the variables shared by the two cliques
+  std::vector<std::pair<UInt, UInt>> edges;
+  std::vector<UIntVec>               sepsets;
+
+  // directed messages in the order they are to be computed, message 2*e goes edges[e].first -> edges[e].second
+  // and 2*e+1 in the other direction (collect to the root first, then distribute)
+  UIntVec message_schedule;
+
+  // smallest clique containing each variable
+  std::map<UInt, UInt> var_to_clique;
+  std::map<UInt, UInt> var_cardinals;
+
+  elimination_stats triangulation_stats;
+
+  // filled by calibrate_junction_tree
+  std::vector<UIntVec> evidence;
+  std::vector<factor> messages;
+  std::vector<factor> beliefs;
+};
+
+
+void get_elimination_cliques(const std::vector<factor*>& factor_vec,
+                             const UIntVec&              elimination_order,
+                                   std::vector<UIntVec>& cliques)
+{
+  // replay the elimination on the interaction graph, each eliminated variable with its
+  // neighbours forms a clique of the triangulated graph
+  interactionGraph     graph;
+  std::map<UInt, UInt> var_cardinals;
+  build_interaction_graph(factor_vec, graph, var_cardinals);
+
+  std::vector<std::set<UInt>> candidate_cliques;
+  for (const UInt var: elimination_order)
+  {
+    const std::set<UInt> neighbours = graph[var];
+    std::set<UInt> clique(neighbours);
+    clique.insert(var);
+    candidate_cliques.push_back(clique);
+
+    for (const UInt neighbour: neighbours)
+    {
+      graph[neighbour].erase(var);
+      graph[neighbour].insert(neighbours.begin(), neighbours.end());
+      graph[neighbour].erase(neighbour);
+    }
+    graph.erase(var);
+  }
+
+  // only keep the maximal cliques
+  cliques.clear();
+  for (std::size_t iter1 = 0u; iter1 < candidate_cliques.size(); iter1++)
+  {
+    bool is_maximal = true;
+    for (std::size_t iter2 = 0u; iter2 < candidate_cliques.size(); iter2++)
+    {
+      if (   (iter1 != iter2)
+          && (std::includes(candidate_cliques[iter2].begin(), candidate_cliques[iter2].end(),
+                            candidate_cliques[iter1].begin(), candidate_cliques[iter1].end()))
+          && (   (candidate_cliques[iter2].size() > candidate_cliques[iter1].size())
+              || (iter2 < iter1)) )
+      {
+        is_maximal = false;
+        break;
+      }
+    }
+    if (is_maximal == true)
+    {  cliques.push_back(UIntVec(candidate_cliques[iter1].begin(), candidate_cliques[iter1].end()));  }
+  }
+}
+
+
+void build_junction_tree(const std::vector<factor*>&  factor_vec,
+                         const elimination_heuristic  heuristic,
+                               junctionTree&          tree)
+{
+  tree = junctionTree();
+  if (factor_vec.empty() == true)
+  {
+    std::cout << "Cannot build junction tree, given factor vector is empty";
+    return;
+  }
+
+  // triangulate by eliminating every variable
+  interactionGraph graph;
+  build_interaction_graph(factor_vec, graph, tree.var_cardinals);
+
+  UIntVec all_vars;
+  for (const std::pair<const UInt, std::set<UInt>>& node: graph)
+  {  all_vars.push_back(node.first);  }
+
+  get_elimination_order(factor_vec, all_vars, heuristic, tree.triangulation_stats);
+  get_elimination_cliques(factor_vec, tree.triangulation_stats.elimination_order, tree.cliques);
+  if (tree.cliques.empty() == true)
+  {
+    std::cout << "Cannot build junction tree, given factors have no variables";
+    return;
+  }
+
+  // connect cliques by a maximum spanning tree on the sepset size (Prim),
+  // this satisfies the running intersection property
+  const std::size_t num_cliques = tree.cliques.size();
+  std::vector<bool> in_tree(num_cliques, false);
+  std::vector<int>  best_link(num_cliques, -1);
+  std::vector<int>  best_weight(num_cliques, -1);
+  in_tree[0] = true;
+  for (std::size_t iter = 1u; iter < num_cliques; iter++)
+  {
+    best_link[iter] = 0;
+    UIntVec intersection_left, intersection_right;
+    get_intersection(tree.cliques[0], tree.cliques[iter], intersection_left, intersection_right);
+    best_weight[iter] = static_cast<int>(intersection_left.size());
+  }
+
+  for (std::size_t added = 1u; added < num_cliques; added++)
+  {
+    int next_clique = -1;
+    for (std::size_t iter = 0u; iter < num_cliques; iter++)
+    {
+      if (   (in_tree[iter] == false)
+          && ((next_clique == -1) || (best_weight[iter] > best_weight[next_clique])) )
+      {  next_clique = static_cast<int>(iter);  }
+    }
+
+    in_tree[next_clique] = true;
+    UIntVec sepset;
+    std::set_intersection(tree.cliques[best_link[next_clique]].begin(), tree.cliques[best_link[next_clique]].end(),
+                          tree.cliques[next_clique].begin(), tree.cliques[next_clique].end(),
+                          std::back_inserter(sepset));
+    tree.edges.push_back(std::make_pair(static_cast<UInt>(next_clique), static_cast<UInt>(best_link[next_clique])));
+    tree.sepsets.push_back(sepset);
+
+    for (std::size_t iter = 0u; iter < num_cliques; iter++)
+    {
+      if (in_tree[iter] == false)
+      {
+        UIntVec intersection_left, intersection_right;
+        get_intersection(tree.cliques[next_clique], tree.cliques[iter], intersection_left, intersection_right);
+        if (static_cast<int>(intersection_left.size()) > best_weight[iter])
+        {
+          best_weight[iter] = static_cast<int>(intersection_left.size());
+          best_link[iter]   = next_clique;
+        }
+      }
+    }
+  }
+
+  // edges were added moving away from the root (clique 0), each edge points child -> parent
+  // collect runs in reverse order of addition (child -> parent), distribute in order (parent -> child)
+  tree.message_schedule.reserve(2u*tree.edges.size());
+  for (std::size_t iter = tree.edges.size(); iter > 0u; iter--)
+  {  tree.message_schedule.push_back(2u*static_cast<UInt>(iter - 1u));  }
+  for (std::size_t iter = 0u; iter < tree.edges.size(); iter++)
+  {  tree.message_schedule.push_back(2u*static_cast<UInt>(iter) + 1u);  }
+
+  // initial clique potentials, every factor is multiplied into one clique that covers its scope
+  tree.clique_potentials.resize(num_cliques);
+  for (std::size_t iter = 0u; iter < num_cliques; iter++)
+  {
+    factor& potential = tree.clique_potentials[iter];
+    potential.variables = tree.cliques[iter];
+    for (const UInt var: tree.cliques[iter])
+    {  potential.cardinals.push_back(tree.var_cardinals[var]);  }
+    potential.values = std::vector<float>(util::vec_prod(potential.cardinals), 1.0f);
+
+    for (const UInt var: tree.cliques[iter])
+    {
+      std::map<UInt, UInt>::iterator var_clique = tree.var_to_clique.find(var);
+      if (   (var_clique == tree.var_to_clique.end())
+          || (tree.cliques[var_clique->second].size() > tree.cliques[iter].size()) )
+      {  tree.var_to_clique[var] = static_cast<UInt>(iter);  }
+    }
+  }
+
+  factor temp;
+  for (const factor* factor_ptr: factor_vec)
+  {
+    const std::set<UInt> factor_scope(factor_ptr->variables.begin(), factor_ptr->variables.end());
+    for (std::size_t iter = 0u; iter < num_cliques; iter++)
+    {
+      if (std::includes(tree.cliques[iter].begin(), tree.cliques[iter].end(),
+                        factor_scope.begin(), factor_scope.end()))
+      {
+        factor_product(tree.clique_potentials[iter], *factor_ptr, temp);
+        std::swap(tree.clique_potentials[iter], temp);
+        break;
+      }
+    }
+  }
+}
+
+
+void compute_clique_message(const junctionTree& tree,
+                            const std::vector<factor>& potentials,
+                            const UInt          message_index,
+                                  factor&       message)
+{
+  // Shafer-Shenoy message, potential of the source clique times every message coming into it
+  // (except the one from the destination), with the non-sepset variables summed out
+  const UInt edge_index  = message_index/2u;
+  const bool is_forward  = (message_index % 2u) == 0u;
+  const UInt from_clique = is_forward ? tree.edges[edge_index].first  : tree.edges[edge_index].second;
+  const UInt to_clique   = is_forward ? tree.edges[edge_index].second : tree.edges[edge_index].first;
+
+  factor product = potentials[from_clique], temp;
+  for (std::size_t iter = 0u; iter < tree.edges.size(); iter++)
+  {
+    if (   (tree.edges[iter].second == from_clique)
+        && (tree.edges[iter].first  != to_clique) )
+    {
+      factor_product(product, tree.messages[2u*iter], temp);
+      std::swap(product, temp);
+    }
+    else if (   (tree.edges[iter].first  == from_clique)
+             && (tree.edges[iter].second != to_clique) )
+    {
+      factor_product(product, tree.messages[2u*iter + 1u], temp);
+      std::swap(product, temp);
+    }
+  }
+
+  UIntVec vars_to_sum;
+  get_difference(product.variables, tree.sepsets[edge_index], vars_to_sum);
+  factor_sum_out(product, vars_to_sum, message);
+}
+
+
+void calibrate_junction_tree(const std::vector<UIntVec>& evidence,
+                                   junctionTree&         tree)
+{
+  // evidence is sliced out of copies of the clique potentials, compiled tree is left untouched
+  std::vector<factor> potentials(tree.clique_potentials.size());
+  for (std::size_t iter = 0u; iter < potentials.size(); iter++)
+  {  factor_reduce(tree.clique_potentials[iter], evidence, potentials[iter]);  }
+  tree.evidence = evidence;
+
+  tree.messages.assign(2u*tree.edges.size(), factor());
+  for (const UInt message_index: tree.message_schedule)
+  {
+    compute_clique_message(tree, potentials, message_index, tree.messages[message_index]);
+  }
+
+  // belief of a clique is its potential times all the incoming messages
+  tree.beliefs = std::move(potentials);
+  factor temp;
+  for (std::size_t iter = 0u; iter < tree.edges.size(); iter++)
+  {
+    factor_product(tree.beliefs[tree.edges[iter].second], tree.messages[2u*iter], temp);
+    std::swap(tree.beliefs[tree.edges[iter].second], temp);
+
+    factor_product(tree.beliefs[tree.edges[iter].first], tree.messages[2u*iter + 1u], temp);
+    std::swap(tree.beliefs[tree.edges[iter].first], temp);
+  }
+}
+
+
+void get_node_marginal(const junctionTree& tree,
+                       const UInt          var,
+                             factor&       factor_marg)
+{
+  std::map<UInt, UInt>::const_iterator var_clique = tree.var_to_clique.find(var);
+  if (var_clique == tree.var_to_clique.end())
+  {
+    std::cout << "given variable -> " << var << " not found in junction tree\n";
+    return;
+  }
+  if (tree.beliefs.empty() == true)
+  {
+    std::cout << "junction tree is not calibrated\n";
+    return;
+  }
+
+  // observed variables are not part of the (reduced) beliefs
+  for (const UIntVec& evidence_elem: tree.evidence)
+  {
+    if (   (evidence_elem[0] == var)
+        && (evidence_elem[1] <  tree.var_cardinals.at(var)) )
+    {
+      factor_marg.variables = UIntVec{var};
+      factor_marg.cardinals = UIntVec{tree.var_cardinals.at(var)};
+      factor_marg.values.assign(tree.var_cardinals.at(var), 0.0f);
+      factor_marg.values[evidence_elem[1]] = 1.0f;
+      return;
+    }
+  }
+
+  const factor& belief = tree.beliefs[var_clique->second];
+  UIntVec vars_to_sum;
+  get_difference(belief.variables, UIntVec{var}, vars_to_sum);
+  factor_sum_out(belief, vars_to_sum, factor_marg);
+  factor_normalize(factor_marg);
+}
+
+
+void compute_all_marginals(const std::vector<UIntVec>&    evidence,
+                                 junctionTree&            tree,
+                                 std::map<UInt, factor>&  marginals)
+{
+  calibrate_junction_tree(evidence, tree);
+  for (const std::pair<const UInt, UInt>& var_clique: tree.var_to_clique)
+  {
+    get_node_marginal(tree, var_clique.first, marginals[var_clique.first]);
+  }
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,455 @@
+#ifndef _BN_LOOPY_BP_H_
+#define _BN_LOOPY_BP_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <chrono>
+#include <functional>
+#include <cmath>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_factor_expression.h"
+#include "BN_parallel.h"
+#include "util.h"
+
+namespace BN
+{
+
+// fewer messages than this are computed on the calling thread
+const std::size_t DEFAULT_MIN_PARALLEL_MESSAGES = 64u;
+
+
+enum bp_schedule
+{
+  BP_SYNCHRONOUS,  // every message recomputed from the previous sweep (flooding)
+  BP_RESIDUAL      // message with the largest pending change first (Elidan et al. 2006)
+};
+
+
+struct bpOptions
+{
+  bp_schedule schedule = BP_RESIDUAL;
+
+  // new message = (1 - damping)*computed + damping*old
+  float damping = 0.0f;
+
+  // converged once no message would change by more than this (max abs difference)
+  float tolerance = 1e-4f;
+
+  // sweeps, one sweep is as many message updates as there are messages
+  UInt max_iterations = 100u;
+
+  // messages committed per residual step before the affected ones are recomputed together
+  std::size_t residual_batch_size = 1u;
+
+  std::size_t min_parallel_messages = DEFAULT_MIN_PARALLEL_MESSAGES;
+};
+
+
+struct bpTelemetry
+{
+  UInt        iterations      = 0u;
+  std::size_t message_updates = 0u;
+  bool        converged       = false;
+
+  // per sweep, largest residual left after it and wall time
+  std::vector<float>  max_residuals;
+  std::vector<double> sweep_times_ms;
+};
+
+
+// factor graph over BN::factor, edge e joins edge_factor[e] and edge_var[e] (local variable index),
+// edges of factor f are [factor_edge_offsets[f], factor_edge_offsets[f+1]) in the order of its variables,
+// edges of variable v are var_edges[var_edge_offsets[v] .. var_edge_offsets[v+1])
+struct loopyBeliefPropagation
+{
+  std::vector<factor>  factors;
+  UIntVec              variables;
+  UIntVec              var_cardinals;
+  std::map<UInt, UInt> var_ids;
+
+  UIntVec edge_factor;
+  UIntVec edge_var;
+  UIntVec factor_edge_offsets;
+  UIntVec var_edge_offsets;
+  UIntVec var_edges;
+
+  // observed state per local variable, -1 if unobserved
+  std::vector<int> observed_states;
+
+  // factor to variable messages, the newly computed ones waiting to be committed and their difference
+  std::vector<factor> messages;
+  std::vector<factor> pending;
+  std::vector<float>  residuals;
+};
+
+
+void build_loopy_bp(const std::vector<factor*>&   factor_vec,
+                          loopyBeliefPropagation& bp)
+{
+  // constant factors carry no information for the beliefs and are left out
+  bp = loopyBeliefPropagation();
+  for (const factor* factor_ptr: factor_vec)
+  {
+    if (factor_ptr->variables.empty() == false)
+    {  bp.factors.push_back(*factor_ptr);  }
+  }
+
+  bp.factor_edge_offsets.push_back(0u);
+  for (UInt factor_id = 0u; factor_id < bp.factors.size(); factor_id++)
+  {
+    const factor& factor_elem = bp.factors[factor_id];
+    for (std::size_t iter = 0u; iter < factor_elem.variables.size(); iter++)
+    {
+      std::map<UInt, UInt>::const_iterator existing = bp.var_ids.find(factor_elem.variables[iter]);
+      UInt var_id;
+      if (existing == bp.var_ids.end())
+      {
+        var_id = static_cast<UInt>(bp.variables.size());
+        bp.var_ids[factor_elem.variables[iter]] = var_id;
+        bp.variables.push_back(factor_elem.variables[iter]);
+        bp.var_cardinals.push_back(factor_elem.cardinals[iter]);
+      }
+      else
+      {  var_id = existing->second;  }
+
+      bp.edge_factor.push_back(factor_id);
+      bp.edge_var.push_back(var_id);
+    }
+    bp.factor_edge_offsets.push_back(static_cast<UInt>(bp.edge_factor.size()));
+  }
+
+  // variable side of the edges, counting sort by variable
+  const UInt num_vars = static_cast<UInt>(bp.variables.size());
+  bp.var_edge_offsets.assign(num_vars + 1u, 0u);
+  for (const UInt var_id: bp.edge_var)
+  {  bp.var_edge_offsets[var_id + 1u]++;  }
+  for (UInt var_id = 0u; var_id < num_vars; var_id++)
+  {  bp.var_edge_offsets[var_id + 1u] += bp.var_edge_offsets[var_id];  }
+
+  UIntVec fill(bp.var_edge_offsets.begin(), bp.var_edge_offsets.end() - 1);
+  bp.var_edges.resize(bp.edge_var.size());
+  for (UInt edge = 0u; edge < bp.edge_var.size(); edge++)
+  {  bp.var_edges[fill[bp.edge_var[edge]]++] = edge;  }
+
+  bp.observed_states.assign(num_vars, -1);
+}
+
+
+void reset_messages(loopyBeliefPropagation& bp)
+{
+  // every message starts uniform
+  const std::size_t num_edges = bp.edge_var.size();
+  bp.messages.resize(num_edges);
+  bp.pending.resize(num_edges);
+  bp.residuals.assign(num_edges, 0.0f);
+  for (std::size_t edge = 0u; edge < num_edges; edge++)
+  {
+    const UInt var_id = bp.edge_var[edge];
+    bp.messages[edge].variables = UIntVec{bp.variables[var_id]};
+    bp.messages[edge].cardinals = UIntVec{bp.var_cardinals[var_id]};
+    bp.messages[edge].values.assign(bp.var_cardinals[var_id], 1.0f/bp.var_cardinals[var_id]);
+  }
+}
+
+
+void normalize_message(factor& message)
+{
+  // messages that became all zero (contradicting evidence) are reset to uniform
+  float total = 0.0f;
+  for (const float value: message.values)
+  {  total += value;  }
+  if (total > 0.0f)
+  {
+    for (float& value: message.values)
+    {  value /= total;  }
+  }
+  else
+  {  std::fill(message.values.begin(), message.values.end(), 1.0f/message.values.size());  }
+}
+
+
+void get_variable_message(const loopyBeliefPropagation& bp,
+                          const UInt                    var_id,
+                          const UInt                    excluded_edge,
+                                factor&                 message)
+{
+  // variable to factor message, product of the messages from every other factor of the variable,
+  // an observed variable only sends its state
+  message.variables = UIntVec{bp.variables[var_id]};
+  message.cardinals = UIntVec{bp.var_cardinals[var_id]};
+  if (bp.observed_states[var_id] != -1)
+  {
+    message.values.assign(bp.var_cardinals[var_id], 0.0f);
+    message.values[bp.observed_states[var_id]] = 1.0f;
+    return;
+  }
+
+  message.values.assign(bp.var_cardinals[var_id], 1.0f);
+  for (UInt iter = bp.var_edge_offsets[var_id]; iter < bp.var_edge_offsets[var_id + 1u]; iter++)
+  {
+    const UInt edge = bp.var_edges[iter];
+    if (edge == excluded_edge)
+    {  continue;  }
+    for (UInt state = 0u; state < bp.var_cardinals[var_id]; state++)
+    {  message.values[state] *= bp.messages[edge].values[state];  }
+  }
+  normalize_message(message);
+}
+
+
+void compute_factor_message(const loopyBeliefPropagation& bp,
+                            const UInt                    edge,
+                                  std::vector<factor>&    variable_messages,
+                                  factor&                 message)
+{
+  // factor to variable message, every other variable of the factor is summed out of the factor times
+  // its incoming message in one fused pass
+  const UInt factor_id  = bp.edge_factor[edge];
+  const UInt edge_begin = bp.factor_edge_offsets[factor_id];
+  const UInt edge_end   = bp.factor_edge_offsets[factor_id + 1u];
+
+  variable_messages.resize(edge_end - edge_begin);
+  std::vector<const factor*> operands {&bp.factors[factor_id]};
+  UIntVec sum_out_vars;
+  for (UInt other_edge = edge_begin; other_edge < edge_end; other_edge++)
+  {
+    if (other_edge == edge)
+    {  continue;  }
+    factor& variable_message = variable_messages[other_edge - edge_begin];
+    get_variable_message(bp, bp.edge_var[other_edge], other_edge, variable_message);
+    operands.push_back(&variable_message);
+    sum_out_vars.push_back(bp.variables[bp.edge_var[other_edge]]);
+  }
+  factor_product_sum_out(operands, sum_out_vars, message);
+  normalize_message(message);
+}
+
+
+void compute_pending_messages(      loopyBeliefPropagation& bp,
+                              const UIntVec&                edges,
+                              const bpOptions&              options,
+                                    Eigen::ThreadPool*      pool)
+{
+  // messages of the given edges are recomputed from the committed ones into pending, each edge only
+  // writes its own slot so the edges can be split across the pool
+  const float damping = options.damping;
+  auto compute_range = [&bp, &edges, damping](const std::size_t begin, const std::size_t end)
+  {
+    std::vector<factor> variable_messages;
+    for (std::size_t iter = begin; iter < end; iter++)
+    {
+      const UInt edge = edges[iter];
+      factor& message = bp.pending[edge];
+      compute_factor_message(bp, edge, variable_messages, message);
+
+      float residual = 0.0f;
+      for (std::size_t state = 0u; state < message.values.size(); state++)
+      {
+        message.values[state] = (1.0f - damping)*message.values[state] + damping*bp.messages[edge].values[state];
+        residual = std::max(residual, std::fabs(message.values[state] - bp.messages[edge].values[state]));
+      }
+      bp.residuals[edge] = residual;
+    }
+  };
+
+  if ((pool != nullptr) && (edges.size() >= options.min_parallel_messages))
+  {  run_chunks(*pool, edges.size(), 1u, compute_range);  }
+  else
+  {  compute_range(0u, edges.size());  }
+}
+
+
+void run_synchronous_bp(      loopyBeliefPropagation& bp,
+                        const bpOptions&              options,
+                              Eigen::ThreadPool*      pool,
+                              bpTelemetry&            telemetry)
+{
+  UIntVec all_edges(bp.edge_var.size());
+  for (UInt edge = 0u; edge < all_edges.size(); edge++)
+  {  all_edges[edge] = edge;  }
+
+  while (telemetry.iterations < options.max_iterations)
+  {
+    const std::chrono::steady_clock::time_point sweep_start = std::chrono::steady_clock::now();
+    compute_pending_messages(bp, all_edges, options, pool);
+
+    float max_residual = 0.0f;
+    for (const UInt edge: all_edges)
+    {
+      max_residual = std::max(max_residual, bp.residuals[edge]);
+      std::swap(bp.messages[edge], bp.pending[edge]);
+    }
+    telemetry.iterations++;
+    telemetry.message_updates += all_edges.size();
+    telemetry.max_residuals.push_back(max_residual);
+    telemetry.sweep_times_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sweep_start).count());
+
+    if (max_residual < options.tolerance)
+    {
+      telemetry.converged = true;
+      break;
+    }
+  }
+}
+
+
+void run_residual_bp(      loopyBeliefPropagation& bp,
+                     const bpOptions&              options,
+                           Eigen::ThreadPool*      pool,
+                           bpTelemetry&            telemetry)
+{
+  // {residual, edge} sorted largest first, an edge's entry is replaced whenever its residual changes
+  const std::size_t num_edges = bp.edge_var.size();
+  UIntVec edges(num_edges);
+  for (UInt edge = 0u; edge < num_edges; edge++)
+  {  edges[edge] = edge;  }
+  compute_pending_messages(bp, edges, options, pool);
+
+  std::set<std::pair<float, UInt>, std::greater<std::pair<float, UInt>>> queue;
+  for (UInt edge = 0u; edge < num_edges; edge++)
+  {  queue.insert(std::make_pair(bp.residuals[edge], edge));  }
+
+  std::vector<bool> is_affected(num_edges, false);
+  UIntVec committed, affected;
+  while ((telemetry.iterations < options.max_iterations) && (telemetry.converged == false))
+  {
+    const std::chrono::steady_clock::time_point sweep_start = std::chrono::steady_clock::now();
+    std::size_t sweep_updates = 0u;
+    while (sweep_updates < num_edges)
+    {
+      if ((queue.empty() == true) || (queue.begin()->first < options.tolerance))
+      {
+        telemetry.converged = true;
+        break;
+      }
+
+      committed.clear();
+      while (   (committed.size() < std::max<std::size_t>(1u, options.residual_batch_size))
+             && (queue.empty() == false)
+             && (queue.begin()->first >= options.tolerance) )
+      {
+        const UInt edge = queue.begin()->second;
+        queue.erase(queue.begin());
+        std::swap(bp.messages[edge], bp.pending[edge]);
+        bp.pending[edge] = bp.messages[edge];
+        bp.residuals[edge] = 0.0f;
+        queue.insert(std::make_pair(0.0f, edge));
+        committed.push_back(edge);
+      }
+
+      // the new message f -> v changes what v sends to its other factors g, so every g -> u (u != v) is recomputed
+      affected.clear();
+      for (const UInt edge: committed)
+      {
+        const UInt var_id = bp.edge_var[edge];
+        for (UInt iter = bp.var_edge_offsets[var_id]; iter < bp.var_edge_offsets[var_id + 1u]; iter++)
+        {
+          const UInt factor_id = bp.edge_factor[bp.var_edges[iter]];
+          if (factor_id == bp.edge_factor[edge])
+          {  continue;  }
+          for (UInt other_edge = bp.factor_edge_offsets[factor_id]; other_edge < bp.factor_edge_offsets[factor_id + 1u]; other_edge++)
+          {
+            if ((bp.edge_var[other_edge] != var_id) && (is_affected[other_edge] == false))
+            {
+              is_affected[other_edge] = true;
+              affected.push_back(other_edge);
+            }
+          }
+        }
+      }
+
+      for (const UInt edge: affected)
+      {  queue.erase(std::make_pair(bp.residuals[edge], edge));  }
+      compute_pending_messages(bp, affected, options, pool);
+      for (const UInt edge: affected)
+      {
+        queue.insert(std::make_pair(bp.residuals[edge], edge));
+        is_affected[edge] = false;
+      }
+
+      sweep_updates += committed.size();
+    }
+
+    telemetry.iterations++;
+    telemetry.message_updates += sweep_updates;
+    telemetry.max_residuals.push_back(queue.empty() ? 0.0f : queue.begin()->first);
+    telemetry.sweep_times_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sweep_start).count());
+  }
+}
+
+
+void run_loopy_bp(      loopyBeliefPropagation& bp,
+                  const std::vector<UIntVec>&   evidence,
+                  const bpOptions&              options,
+                        Eigen::ThreadPool*      pool,
+                        bpTelemetry&            telemetry)
+{
+  // messages restart from uniform for every evidence set, evidence on variables outside the graph is ignored
+  telemetry = bpTelemetry();
+  std::fill(bp.observed_states.begin(), bp.observed_states.end(), -1);
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    std::map<UInt, UInt>::const_iterator var = bp.var_ids.find(evidence_elem[0]);
+    if ((var != bp.var_ids.end()) && (evidence_elem[1] < bp.var_cardinals[var->second]))
+    {  bp.observed_states[var->second] = static_cast<int>(evidence_elem[1]);  }
+  }
+  reset_messages(bp);
+
+  if (options.schedule == BP_SYNCHRONOUS)
+  {  run_synchronous_bp(bp, options, pool, telemetry);  }
+  else
+  {  run_residual_bp(bp, options, pool, telemetry);  }
+}
+
+
+void get_belief(const loopyBeliefPropagation& bp,
+                const UInt                    var,
+                      factor&                 belief)
+{
+  // normalized product of every message into var (one-hot if var is observed)
+  std::map<UInt, UInt>::const_iterator var_id = bp.var_ids.find(var);
+  if (var_id == bp.var_ids.end())
+  {
+    std::cout << "given variable -> " << var << " is not in the factor graph\n";
+    belief = factor();
+    return;
+  }
+  get_variable_message(bp, var_id->second, static_cast<UInt>(bp.edge_var.size()), belief);
+}
+
+
+void compute_all_marginals(const std::vector<UIntVec>&   evidence,
+                                 loopyBeliefPropagation& bp,
+                           const bpOptions&              options,
+                                 Eigen::ThreadPool&      pool,
+                                 std::map<UInt, factor>& marginals,
+                                 bpTelemetry&            telemetry)
+{
+  run_loopy_bp(bp, evidence, options, &pool, telemetry);
+  marginals.clear();
+  for (const UInt var: bp.variables)
+  {  get_belief(bp, var, marginals[var]);  }
+}
+
+
+void compute_all_marginals(const std::vector<UIntVec>&   evidence,
+                                 loopyBeliefPropagation& bp,
+                           const bpOptions&              options,
+                                 std::map<UInt, factor>& marginals,
+                                 bpTelemetry&            telemetry)
+{
+  run_loopy_bp(bp, evidence, options, nullptr, telemetry);
+  marginals.clear();
+  for (const UInt var: bp.variables)
+  {  get_belief(bp, var, marginals[var]);  }
+}
+
+} // end namespace {BN}
+
+#endif
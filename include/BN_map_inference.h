@@ -0,0 +1,435 @@
+#ifndef _BN_MAP_INFERENCE_H_
+#define _BN_MAP_INFERENCE_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <limits>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_factor_pool.h"
+#include "BN_variable_elimination.h"
+#include "util.h"
+
+namespace BN
+{
+
+// what max_eliminate_var leaves behind for the traceback, the best state of var
+// for every assignment of the variables it was maxed out against
+struct maxBackpointer
+{
+  UInt    var;
+  UIntVec variables;
+  UIntVec cardinals;
+  UIntVec argmax;
+};
+
+
+struct mapSearchStats
+{
+  // search nodes whose children were generated, and children discarded by their bound
+  std::size_t nodes_expanded = 0u;
+  std::size_t nodes_pruned   = 0u;
+
+  // mini-bucket bound of the whole problem, P(MAP, evidence) is never above it
+  float root_bound = 0.0f;
+};
+
+
+void max_eliminate_var(      std::vector<factor*>&        factors,
+                       const UInt                         var,
+                             factorPool&                  pool,
+                             std::vector<maxBackpointer>& backpointers)
+{
+  // eliminate_var with max in place of sum, the argmax table is kept for the traceback
+  std::size_t num_kept = 0u;
+  factor* product = nullptr;
+  for (std::size_t iter = 0u; iter < factors.size(); iter++)
+  {
+    factor* factor_ptr = factors[iter];
+    if (get_var_index(*factor_ptr, var) == -1)
+    {
+      factors[num_kept] = factor_ptr;
+      num_kept++;
+    }
+    else if (product == nullptr)
+    {
+      product = factor_ptr;
+    }
+    else
+    {
+      factor& product_result = pool_acquire(pool);
+      factor_product(*product, *factor_ptr, product_result);
+      pool_release(pool, *product);
+      pool_release(pool, *factor_ptr);
+      product = &product_result;
+    }
+  }
+  factors.resize(num_kept);
+
+  if (product != nullptr)
+  {
+    factor& max_result = pool_acquire(pool);
+    backpointers.push_back(maxBackpointer());
+    backpointers.back().var = var;
+    factor_max_out(*product, UIntVec{var}, max_result, backpointers.back().argmax);
+    backpointers.back().variables = max_result.variables;
+    backpointers.back().cardinals = max_result.cardinals;
+    pool_release(pool, *product);
+    factors.push_back(&max_result);
+  }
+}
+
+
+void compute_mpe_ve(const std::vector<UIntVec>&  evidence,
+                    const std::vector<factor*>&  factor_vec,
+                          std::vector<UIntVec>&  mpe_assignment,
+                          float&                 mpe_probability,
+                    const elimination_heuristic  heuristic,
+                          factorPool&            pool,
+                          elimination_stats&     stats)
+{
+  // most probable explanation, every unobserved variable is maxed out along the elimination order
+  // and the assignment is read back from the argmax tables in reverse order, the joint is never built.
+  // mpe_assignment is {variable, state} sorted by variable (observed ones included),
+  // mpe_probability is P(assignment, evidence)
+  mpe_assignment.clear();
+  mpe_probability = 0.0f;
+  if (factor_vec.empty() == true)
+  {
+    std::cout << "Cannot compute MPE, given factor vector is empty";
+    return;
+  }
+
+  // constants left by the evidence are kept, they scale mpe_probability
+  std::vector<factor*> factors;
+  factors.reserve(factor_vec.size());
+  std::set<UInt> all_vars;
+  for (const factor* factor_ptr: factor_vec)
+  {
+    factor& reduced = pool_acquire(pool);
+    factor_reduce(*factor_ptr, evidence, reduced);
+    all_vars.insert(reduced.variables.begin(), reduced.variables.end());
+    factors.push_back(&reduced);
+  }
+
+  get_elimination_order(factors, UIntVec(all_vars.begin(), all_vars.end()), heuristic, stats);
+
+  std::vector<maxBackpointer> backpointers;
+  backpointers.reserve(stats.elimination_order.size());
+  for (const UInt var: stats.elimination_order)
+  {
+    max_eliminate_var(factors, var, pool, backpointers);
+  }
+
+  mpe_probability = 1.0f;
+  for (const factor* factor_ptr: factors)
+  {  mpe_probability *= factor_ptr->values[0];  }
+  pool_release_all(pool);
+
+  // every variable a table depends on was eliminated after it, so it is already assigned
+  std::map<UInt, UInt> states;
+  for (const UIntVec& evidence_elem: evidence)
+  {  states[evidence_elem[0]] = evidence_elem[1];  }
+  for (std::size_t iter = backpointers.size(); iter > 0u; iter--)
+  {
+    const maxBackpointer& backpointer = backpointers[iter - 1u];
+    UInt index = 0u, stride = 1u;
+    for (std::size_t var_iter = 0u; var_iter < backpointer.variables.size(); var_iter++)
+    {
+      index  += states[backpointer.variables[var_iter]]*stride;
+      stride *= backpointer.cardinals[var_iter];
+    }
+    states[backpointer.var] = backpointer.argmax[index];
+  }
+
+  for (const std::pair<const UInt, UInt>& state: states)
+  {  mpe_assignment.push_back(UIntVec{state.first, state.second});  }
+}
+
+
+void compute_mpe_ve(const std::vector<UIntVec>&  evidence,
+                    const std::vector<factor*>&  factor_vec,
+                          std::vector<UIntVec>&  mpe_assignment,
+                          float&                 mpe_probability)
+{
+  factorPool pool;
+  elimination_stats stats;
+  compute_mpe_ve(evidence, factor_vec, mpe_assignment, mpe_probability, MIN_FILL, pool, stats);
+}
+
+
+float mini_bucket_bound(const std::vector<factor*>& factor_vec,
+                        const UIntVec&              elimination_order,
+                        const std::set<UInt>&       max_vars,
+                        const UInt                  i_bound,
+                              factorPool&           pool)
+{
+  // mini-bucket elimination (Dechter & Rish 2003), the factors of a bucket are split into mini-buckets
+  // of at most i_bound variables; for a summed variable the first mini-bucket is summed and the rest
+  // maxed, max_vars are maxed in every mini-bucket. the result is an upper bound on
+  // max over max_vars of the sum over the rest, exact once i_bound covers the induced width.
+  // elimination_order has to list every variable of factor_vec
+  std::vector<factor*> factors;
+  factors.reserve(factor_vec.size());
+  for (const factor* factor_ptr: factor_vec)
+  {
+    factor& copy = pool_acquire(pool);
+    copy = *factor_ptr;
+    factors.push_back(&copy);
+  }
+
+  std::vector<factor*> bucket;
+  std::vector<std::vector<factor*>> mini_buckets;
+  std::vector<std::set<UInt>> mini_bucket_scopes;
+  UIntVec argmax;
+  for (const UInt var: elimination_order)
+  {
+    bucket.clear();
+    std::size_t num_kept = 0u;
+    for (factor* factor_ptr: factors)
+    {
+      if (get_var_index(*factor_ptr, var) == -1)
+      {  factors[num_kept++] = factor_ptr;  }
+      else
+      {  bucket.push_back(factor_ptr);  }
+    }
+    factors.resize(num_kept);
+    if (bucket.empty() == true)
+    {  continue;  }
+
+    // first fit, largest scopes first
+    std::stable_sort(bucket.begin(), bucket.end(),
+                     [](const factor* left, const factor* right) {  return left->variables.size() > right->variables.size();  });
+    mini_buckets.clear();
+    mini_bucket_scopes.clear();
+    for (factor* factor_ptr: bucket)
+    {
+      std::size_t target = 0u;
+      for (; target < mini_buckets.size(); target++)
+      {
+        std::set<UInt> merged = mini_bucket_scopes[target];
+        merged.insert(factor_ptr->variables.begin(), factor_ptr->variables.end());
+        if (merged.size() <= i_bound)
+        {
+          mini_bucket_scopes[target] = std::move(merged);
+          break;
+        }
+      }
+      if (target == mini_buckets.size())
+      {
+        mini_buckets.push_back(std::vector<factor*>());
+        mini_bucket_scopes.push_back(std::set<UInt>(factor_ptr->variables.begin(), factor_ptr->variables.end()));
+      }
+      mini_buckets[target].push_back(factor_ptr);
+    }
+
+    const bool is_max_var = max_vars.find(var) != max_vars.end();
+    for (std::size_t target = 0u; target < mini_buckets.size(); target++)
+    {
+      factor* product = mini_buckets[target][0];
+      for (std::size_t iter = 1u; iter < mini_buckets[target].size(); iter++)
+      {
+        factor& product_result = pool_acquire(pool);
+        factor_product(*product, *mini_buckets[target][iter], product_result);
+        pool_release(pool, *product);
+        pool_release(pool, *mini_buckets[target][iter]);
+        product = &product_result;
+      }
+
+      factor& message = pool_acquire(pool);
+      if ((is_max_var == false) && (target == 0u))
+      {  factor_sum_out(*product, UIntVec{var}, message);  }
+      else
+      {  factor_max_out(*product, UIntVec{var}, message, argmax);  }
+      pool_release(pool, *product);
+      factors.push_back(&message);
+    }
+  }
+
+  float bound = 1.0f;
+  for (const factor* factor_ptr: factors)
+  {  bound *= factor_ptr->values[0];  }
+  pool_release_all(pool);
+  return bound;
+}
+
+
+struct mapSearchContext
+{
+  UIntVec              search_vars;
+  std::map<UInt, UInt> var_cardinals;
+  UIntVec              elimination_order;
+  std::set<UInt>       max_vars;
+  UInt                 i_bound;
+  factorPool           pool;
+
+  std::vector<UIntVec> assignment;
+  std::vector<UIntVec> best_assignment;
+  float                best_probability;
+  mapSearchStats       stats;
+};
+
+
+void map_search(      std::vector<factor>& factors,
+                const std::size_t          depth,
+                      mapSearchContext&    context)
+{
+  // depth first over search_vars, every child is conditioned on its state and scored by the
+  // mini-bucket bound of what is left, children are visited best bound first and dropped
+  // as soon as their bound can't beat the best complete assignment found so far
+  std::vector<factor*> factor_ptrs;
+  if (depth == context.search_vars.size())
+  {
+    // only summed variables are left, bucket elimination without a bound on the size is exact
+    for (factor& factor_elem: factors)
+    {  factor_ptrs.push_back(&factor_elem);  }
+    const float probability = mini_bucket_bound(factor_ptrs, context.elimination_order, context.max_vars,
+                                                std::numeric_limits<UInt>::max(), context.pool);
+    if (probability > context.best_probability)
+    {
+      context.best_probability = probability;
+      context.best_assignment  = context.assignment;
+    }
+    return;
+  }
+
+  context.stats.nodes_expanded++;
+  const UInt var      = context.search_vars[depth];
+  const UInt cardinal = context.var_cardinals[var];
+
+  std::vector<std::vector<factor>> children(cardinal);
+  std::vector<std::pair<float, UInt>> child_bounds;
+  for (UInt state = 0u; state < cardinal; state++)
+  {
+    const std::vector<UIntVec> condition {UIntVec{var, state}};
+    children[state].resize(factors.size());
+    factor_ptrs.clear();
+    for (std::size_t iter = 0u; iter < factors.size(); iter++)
+    {
+      factor_reduce(factors[iter], condition, children[state][iter]);
+      factor_ptrs.push_back(&children[state][iter]);
+    }
+    child_bounds.push_back(std::make_pair(mini_bucket_bound(factor_ptrs, context.elimination_order, context.max_vars,
+                                                            context.i_bound, context.pool), state));
+  }
+  std::stable_sort(child_bounds.begin(), child_bounds.end(),
+                   [](const std::pair<float, UInt>& left, const std::pair<float, UInt>& right) {  return left.first > right.first;  });
+
+  for (const std::pair<float, UInt>& child: child_bounds)
+  {
+    if (child.first <= context.best_probability)
+    {
+      context.stats.nodes_pruned++;
+      continue;
+    }
+    context.assignment.push_back(UIntVec{var, child.second});
+    map_search(children[child.second], depth + 1u, context);
+    context.assignment.pop_back();
+  }
+}
+
+
+void compute_map_bnb(const std::vector<UInt>&     map_vars,
+                     const std::vector<UIntVec>&  evidence,
+                     const std::vector<factor*>&  factor_vec,
+                     const UInt                   i_bound,
+                           std::vector<UIntVec>&  map_assignment,
+                           float&                 map_probability,
+                           mapSearchStats&        stats)
+{
+  // MAP, the most probable assignment of map_vars with every other unobserved variable summed out,
+  // by branch and bound over map_vars with mini-bucket upper bounds (i_bound variables per mini-bucket),
+  // with map_vars covering every variable this is MPE.
+  // map_assignment is {variable, state} sorted by variable (observed map_vars included),
+  // map_probability is P(assignment, evidence)
+  map_assignment.clear();
+  map_probability = 0.0f;
+  stats = mapSearchStats();
+  if (factor_vec.empty() == true)
+  {
+    std::cout << "Cannot compute MAP, given factor vector is empty";
+    return;
+  }
+  if (i_bound == 0u)
+  {
+    std::cout << "i_bound has to be at least 1\n";
+    return;
+  }
+
+  mapSearchContext context;
+  context.i_bound          = i_bound;
+  context.best_probability = -1.0f;
+
+  // constants left by the evidence are kept, they scale map_probability
+  std::vector<factor> factors(factor_vec.size());
+  for (std::size_t iter = 0u; iter < factor_vec.size(); iter++)
+  {  factor_reduce(*factor_vec[iter], evidence, factors[iter]);  }
+
+  std::vector<factor*> factor_ptrs;
+  for (factor& factor_elem: factors)
+  {
+    factor_ptrs.push_back(&factor_elem);
+    for (std::size_t iter = 0u; iter < factor_elem.variables.size(); iter++)
+    {  context.var_cardinals[factor_elem.variables[iter]] = factor_elem.cardinals[iter];  }
+  }
+
+  // summed variables go first in the elimination order, the search assigns map variables
+  // in the reverse of their elimination order
+  UIntVec sum_vars, max_vars;
+  for (const std::pair<const UInt, UInt>& var_cardinal: context.var_cardinals)
+  {
+    if (std::find(map_vars.begin(), map_vars.end(), var_cardinal.first) == map_vars.end())
+    {  sum_vars.push_back(var_cardinal.first);  }
+    else
+    {  max_vars.push_back(var_cardinal.first);  }
+  }
+  elimination_stats order_stats;
+  get_elimination_order(factor_ptrs, sum_vars, MIN_FILL, order_stats);
+  context.elimination_order = order_stats.elimination_order;
+  get_elimination_order(factor_ptrs, max_vars, MIN_FILL, order_stats);
+  context.elimination_order.insert(context.elimination_order.end(),
+                                   order_stats.elimination_order.begin(), order_stats.elimination_order.end());
+  context.search_vars.assign(order_stats.elimination_order.rbegin(), order_stats.elimination_order.rend());
+  context.max_vars.insert(max_vars.begin(), max_vars.end());
+
+  context.stats.root_bound = mini_bucket_bound(factor_ptrs, context.elimination_order, context.max_vars,
+                                               context.i_bound, context.pool);
+  map_search(factors, 0u, context);
+  stats = context.stats;
+
+  // map variables no factor depends on can take any state, they are reported as 0
+  std::map<UInt, UInt> states;
+  for (const UInt var: map_vars)
+  {  states[var] = 0u;  }
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    if (states.find(evidence_elem[0]) != states.end())
+    {  states[evidence_elem[0]] = evidence_elem[1];  }
+  }
+  for (const UIntVec& state: context.best_assignment)
+  {  states[state[0]] = state[1];  }
+
+  for (const std::pair<const UInt, UInt>& state: states)
+  {  map_assignment.push_back(UIntVec{state.first, state.second});  }
+  map_probability = std::max(context.best_probability, 0.0f);
+}
+
+
+void compute_map_bnb(const std::vector<UInt>&     map_vars,
+                     const std::vector<UIntVec>&  evidence,
+                     const std::vector<factor*>&  factor_vec,
+                     const UInt                   i_bound,
+                           std::vector<UIntVec>&  map_assignment,
+                           float&                 map_probability)
+{
+  mapSearchStats stats;
+  compute_map_bnb(map_vars, evidence, factor_vec, i_bound, map_assignment, map_probability, stats);
+}
+
+} // end namespace {BN}
+
+#endif
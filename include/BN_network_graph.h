@@ -0,0 +1,243 @@
+#ifndef _BN_NETWORK_GRAPH_H_
+#define _BN_NETWORK_GRAPH_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "util.h"
+
+namespace BN
+{
+
+// collects named nodes and edges, node names are interned into dense ids (0, 1, ...) in order of appearance
+struct networkGraphBuilder
+{
+  std::vector<std::string>              node_names;
+  std::unordered_map<std::string, UInt> node_ids;
+
+  // variable index of each node, the id unless given explicitly
+  UIntVec node_vars;
+
+  // {parent id, child id}
+  std::vector<std::pair<UInt, UInt>> edges;
+};
+
+
+// immutable network structure, adjacency of node n is
+//   parents[parent_offsets[n] .. parent_offsets[n+1]),  children[child_offsets[n] .. child_offsets[n+1])
+struct networkGraph
+{
+  std::vector<std::string>              node_names;
+  std::unordered_map<std::string, UInt> node_ids;
+  UIntVec                               node_vars;
+
+  UIntVec parent_offsets;
+  UIntVec parents;
+  UIntVec child_offsets;
+  UIntVec children;
+};
+
+
+UInt add_node(      networkGraphBuilder& builder,
+              const std::string&         name,
+              const UInt                 var)
+{
+  std::unordered_map<std::string, UInt>::const_iterator existing = builder.node_ids.find(name);
+  if (existing != builder.node_ids.end())
+  {  return existing->second;  }
+
+  const UInt id = static_cast<UInt>(builder.node_names.size());
+  builder.node_names.push_back(name);
+  builder.node_ids[name] = id;
+  builder.node_vars.push_back(var);
+  return id;
+}
+
+
+UInt add_node(      networkGraphBuilder& builder,
+              const std::string&         name)
+{
+  return add_node(builder, name, static_cast<UInt>(builder.node_names.size()));
+}
+
+
+void add_edge(      networkGraphBuilder& builder,
+              const std::string&         parent_name,
+              const std::string&         child_name)
+{
+  // unknown names are added as new nodes
+  const UInt parent_id = add_node(builder, parent_name);
+  const UInt child_id  = add_node(builder, child_name);
+  builder.edges.push_back(std::make_pair(parent_id, child_id));
+}
+
+
+void fill_csr(const UInt                                num_nodes,
+              const std::vector<std::pair<UInt, UInt>>& edges,
+              const bool                                by_child,
+                    UIntVec&                            offsets,
+                    UIntVec&                            adjacent)
+{
+  // counting sort of the edges by their parent (or child) id, adjacency keeps the insertion order
+  offsets.assign(num_nodes + 1u, 0u);
+  for (const std::pair<UInt, UInt>& edge: edges)
+  {  offsets[(by_child ? edge.second : edge.first) + 1u]++;  }
+  for (UInt node = 0u; node < num_nodes; node++)
+  {  offsets[node + 1u] += offsets[node];  }
+
+  UIntVec fill(offsets.begin(), offsets.end() - 1);
+  adjacent.resize(edges.size());
+  for (const std::pair<UInt, UInt>& edge: edges)
+  {
+    if (by_child == true)
+    {  adjacent[fill[edge.second]++] = edge.first;  }
+    else
+    {  adjacent[fill[edge.first]++]  = edge.second;  }
+  }
+}
+
+
+void build_network_graph(const networkGraphBuilder& builder,
+                               networkGraph&        graph)
+{
+  const UInt num_nodes = static_cast<UInt>(builder.node_names.size());
+  graph.node_names = builder.node_names;
+  graph.node_ids   = builder.node_ids;
+  graph.node_vars  = builder.node_vars;
+  fill_csr(num_nodes, builder.edges, true,  graph.parent_offsets, graph.parents);
+  fill_csr(num_nodes, builder.edges, false, graph.child_offsets,  graph.children);
+}
+
+
+void build_network_graph(const std::map<std::string, std::shared_ptr<networkNode>>& network,
+                               networkGraph&                                        graph)
+{
+  // conversion from the add_edge map, node_index becomes the node variable
+  networkGraphBuilder builder;
+  std::map<const networkNode*, UInt> pointer_ids;
+  for (const std::pair<const std::string, std::shared_ptr<networkNode>>& node: network)
+  {  pointer_ids[node.second.get()] = add_node(builder, node.first, node.second->node_index);  }
+
+  for (const std::pair<const std::string, std::shared_ptr<networkNode>>& node: network)
+  {
+    for (const std::shared_ptr<networkNode>& child: node.second->children)
+    {
+      std::map<const networkNode*, UInt>::const_iterator child_id = pointer_ids.find(child.get());
+      if (child_id != pointer_ids.end())
+      {  builder.edges.push_back(std::make_pair(pointer_ids[node.second.get()], child_id->second));  }
+    }
+  }
+  build_network_graph(builder, graph);
+}
+
+
+int get_node_id(const networkGraph& graph,
+                const std::string&  name)
+{
+  std::unordered_map<std::string, UInt>::const_iterator node = graph.node_ids.find(name);
+  if (node == graph.node_ids.end())
+  {  return -1;  }
+  return static_cast<int>(node->second);
+}
+
+
+bool topological_sort(const networkGraph& graph,
+                            UIntVec&      order)
+{
+  // Kahn's algorithm on the child arrays, returns false if the graph has a cycle
+  const UInt num_nodes = static_cast<UInt>(graph.node_names.size());
+  UIntVec num_unvisited_parents(num_nodes);
+  order.clear();
+  for (UInt node = 0u; node < num_nodes; node++)
+  {
+    num_unvisited_parents[node] = graph.parent_offsets[node + 1u] - graph.parent_offsets[node];
+    if (num_unvisited_parents[node] == 0u)
+    {  order.push_back(node);  }
+  }
+
+  // order doubles as the queue
+  for (std::size_t head = 0u; head < order.size(); head++)
+  {
+    const UInt node = order[head];
+    for (UInt iter = graph.child_offsets[node]; iter < graph.child_offsets[node + 1u]; iter++)
+    {
+      if (--num_unvisited_parents[graph.children[iter]] == 0u)
+      {  order.push_back(graph.children[iter]);  }
+    }
+  }
+
+  if (order.size() != num_nodes)
+  {
+    std::cout << "network has a cycle, couldn't sort it topologically\n";
+    return false;
+  }
+  return true;
+}
+
+
+void moralize(const networkGraph& graph,
+                    UIntVec&      neighbour_offsets,
+                    UIntVec&      neighbours)
+{
+  // undirected moral graph in the same CSR layout, neighbours of a node are its parents, children
+  // and the other parents of its children (sorted, no duplicates)
+  const UInt num_nodes = static_cast<UInt>(graph.node_names.size());
+  neighbour_offsets.assign(1u, 0u);
+  neighbours.clear();
+
+  UIntVec node_neighbours;
+  for (UInt node = 0u; node < num_nodes; node++)
+  {
+    node_neighbours.assign(graph.parents.begin() + graph.parent_offsets[node],
+                           graph.parents.begin() + graph.parent_offsets[node + 1u]);
+    for (UInt iter = graph.child_offsets[node]; iter < graph.child_offsets[node + 1u]; iter++)
+    {
+      const UInt child = graph.children[iter];
+      node_neighbours.push_back(child);
+      node_neighbours.insert(node_neighbours.end(),
+                             graph.parents.begin() + graph.parent_offsets[child],
+                             graph.parents.begin() + graph.parent_offsets[child + 1u]);
+    }
+    std::sort(node_neighbours.begin(), node_neighbours.end());
+    node_neighbours.erase(std::unique(node_neighbours.begin(), node_neighbours.end()), node_neighbours.end());
+    node_neighbours.erase(std::remove(node_neighbours.begin(), node_neighbours.end(), node), node_neighbours.end());
+
+    neighbours.insert(neighbours.end(), node_neighbours.begin(), node_neighbours.end());
+    neighbour_offsets.push_back(static_cast<UInt>(neighbours.size()));
+  }
+}
+
+
+void get_ancestors(const networkGraph& graph,
+                   const UIntVec&      nodes,
+                         UIntVec&      ancestors)
+{
+  // given nodes and all their ancestors, sorted by id
+  std::vector<bool> is_visited(graph.node_names.size(), false);
+  UIntVec to_visit(nodes);
+  ancestors.clear();
+  while (to_visit.empty() == false)
+  {
+    const UInt node = to_visit.back();
+    to_visit.pop_back();
+    if (is_visited[node] == true)
+    {  continue;  }
+
+    is_visited[node] = true;
+    ancestors.push_back(node);
+    to_visit.insert(to_visit.end(),
+                    graph.parents.begin() + graph.parent_offsets[node],
+                    graph.parents.begin() + graph.parent_offsets[node + 1u]);
+  }
+  std::sort(ancestors.begin(), ancestors.end());
+}
+
+} // end namespace {BN}
+
+#endif
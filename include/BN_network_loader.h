@@ -0,0 +1,613 @@
+#ifndef _BN_NETWORK_LOADER_H_
+#define _BN_NETWORK_LOADER_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "util.h"
+
+namespace BN
+{
+
+const std::size_t LOADER_BUFFER_SIZE = 1u << 16;
+const std::size_t LOADER_TOKEN_SIZE  = 256u;
+
+// BIF tables are allocated before their rows are read (rows come in any order), larger ones are refused
+const std::uint64_t LOADER_MAX_BIF_TABLE_SIZE = 1u << 28;
+
+
+// what the files say about the variables, variable i of the loaded factors is entry i
+struct networkFileInfo
+{
+  bool                                  is_markov = false;
+  UIntVec                               cardinals;
+  std::vector<std::string>              var_names;
+  std::vector<std::vector<std::string>> state_names;
+};
+
+
+// reads a file through one fixed buffer, tokens are copied into a fixed array (no string per token)
+struct fileTokenizer
+{
+  std::FILE*        file = nullptr;
+  std::vector<char> buffer;
+  std::size_t       position = 0u;
+  std::size_t       end      = 0u;
+
+  char        token[LOADER_TOKEN_SIZE];
+  std::size_t token_length = 0u;
+
+  // set by a token that doesn't fit, no tokens are returned after that
+  bool is_malformed = false;
+
+  fileTokenizer() = default;
+  fileTokenizer(const fileTokenizer&) = delete;
+  fileTokenizer& operator=(const fileTokenizer&) = delete;
+  ~fileTokenizer()
+  {
+    if (file != nullptr)
+    {  std::fclose(file);  }
+  }
+};
+
+
+bool open_tokenizer(const std::string&   file_path,
+                          fileTokenizer& tokenizer)
+{
+  tokenizer.file = std::fopen(file_path.c_str(), "rb");
+  if (tokenizer.file == nullptr)
+  {
+    std::cout << "couldn't open " << file_path << '\n';
+    return false;
+  }
+  tokenizer.buffer.resize(LOADER_BUFFER_SIZE);
+  tokenizer.position = 0u;
+  tokenizer.end      = 0u;
+  return true;
+}
+
+
+int peek_char(fileTokenizer& tokenizer)
+{
+  if (tokenizer.position == tokenizer.end)
+  {
+    tokenizer.end      = std::fread(tokenizer.buffer.data(), 1u, tokenizer.buffer.size(), tokenizer.file);
+    tokenizer.position = 0u;
+    if (tokenizer.end == 0u)
+    {  return EOF;  }
+  }
+  return static_cast<unsigned char>(tokenizer.buffer[tokenizer.position]);
+}
+
+
+int get_char(fileTokenizer& tokenizer)
+{
+  const int next = peek_char(tokenizer);
+  if (next != EOF)
+  {  tokenizer.position++;  }
+  return next;
+}
+
+
+bool is_token_punctuation(const int next)
+{
+  return (next == '{') || (next == '}') || (next == '[') || (next == ']') || (next == '(') || (next == ')')
+      || (next == '|') || (next == ',') || (next == ';');
+}
+
+
+bool next_token(fileTokenizer& tokenizer)
+{
+  // skips white space and // or /* */ comments, punctuation characters are tokens of their own,
+  // a token longer than LOADER_TOKEN_SIZE - 1 marks the input as malformed
+  tokenizer.token_length = 0u;
+  if (tokenizer.is_malformed == true)
+  {  return false;  }
+
+  int next = peek_char(tokenizer);
+  while (next != EOF)
+  {
+    if ((next == ' ') || (next == '\t') || (next == '\n') || (next == '\r'))
+    {
+      get_char(tokenizer);
+    }
+    else if (next == '/')
+    {
+      get_char(tokenizer);
+      const int comment_type = peek_char(tokenizer);
+      if (comment_type == '/')
+      {
+        while ((next != EOF) && (next != '\n'))
+        {  next = get_char(tokenizer);  }
+      }
+      else if (comment_type == '*')
+      {
+        get_char(tokenizer);
+        int previous = 0;
+        next = get_char(tokenizer);
+        while ((next != EOF) && ((previous != '*') || (next != '/')))
+        {
+          previous = next;
+          next = get_char(tokenizer);
+        }
+      }
+      else
+      {
+        tokenizer.token[tokenizer.token_length++] = '/';
+        break;
+      }
+    }
+    else
+    {  break;  }
+    next = peek_char(tokenizer);
+  }
+
+  next = peek_char(tokenizer);
+  if ((next == EOF) && (tokenizer.token_length == 0u))
+  {  return false;  }
+
+  if ((tokenizer.token_length == 0u) && (is_token_punctuation(next) == true))
+  {
+    tokenizer.token[tokenizer.token_length++] = static_cast<char>(get_char(tokenizer));
+  }
+  else
+  {
+    while (   (next != EOF) && (next != ' ') && (next != '\t') && (next != '\n') && (next != '\r')
+           && (is_token_punctuation(next) == false)
+           && (tokenizer.token_length + 1u < LOADER_TOKEN_SIZE) )
+    {
+      tokenizer.token[tokenizer.token_length++] = static_cast<char>(get_char(tokenizer));
+      next = peek_char(tokenizer);
+    }
+    tokenizer.token[tokenizer.token_length] = '\0';
+    if (   (tokenizer.token_length + 1u == LOADER_TOKEN_SIZE)
+        && (next != EOF) && (next != ' ') && (next != '\t') && (next != '\n') && (next != '\r')
+        && (is_token_punctuation(next) == false) )
+    {
+      tokenizer.is_malformed = true;
+      return false;
+    }
+  }
+  tokenizer.token[tokenizer.token_length] = '\0';
+  return true;
+}
+
+
+bool token_is(const fileTokenizer& tokenizer,
+              const char*          text)
+{
+  return std::strcmp(tokenizer.token, text) == 0;
+}
+
+
+bool read_uint(fileTokenizer& tokenizer,
+               UInt&          value)
+{
+  if ((next_token(tokenizer) == false) || (tokenizer.token[0] < '0') || (tokenizer.token[0] > '9'))
+  {  return false;  }
+
+  char* parse_end;
+  value = static_cast<UInt>(std::strtoul(tokenizer.token, &parse_end, 10));
+  return *parse_end == '\0';
+}
+
+
+bool read_float(fileTokenizer& tokenizer,
+                float&         value)
+{
+  if (next_token(tokenizer) == false)
+  {  return false;  }
+
+  char* parse_end;
+  value = std::strtof(tokenizer.token, &parse_end);
+  return (parse_end != tokenizer.token) && (*parse_end == '\0');
+}
+
+
+bool expect_token(fileTokenizer& tokenizer,
+                  const char*    text)
+{
+  return (next_token(tokenizer) == true) && (token_is(tokenizer, text) == true);
+}
+
+
+/* ---- UAI ---- */
+
+bool load_uai(const std::string&         file_path,
+                    std::vector<factor>& factors,
+                    networkFileInfo&     info)
+{
+  // UAI tables list the last scope variable fastest, scopes are stored reversed so the values can be
+  // copied in file order (for BAYES networks this also puts the child first, as in the rest of BN)
+  fileTokenizer tokenizer;
+  if (open_tokenizer(file_path, tokenizer) == false)
+  {  return false;  }
+
+  if (next_token(tokenizer) == false)
+  {
+    std::cout << file_path << " is empty\n";
+    return false;
+  }
+  info = networkFileInfo();
+  info.is_markov = token_is(tokenizer, "MARKOV");
+  if ((info.is_markov == false) && (token_is(tokenizer, "BAYES") == false))
+  {
+    std::cout << file_path << ": expected BAYES or MARKOV, found " << tokenizer.token << '\n';
+    return false;
+  }
+
+  // counts in the header aren't trusted for allocation, everything grows only as entries are
+  // actually read, so a hostile count ends in the malformed error instead of a huge allocation
+  UInt num_vars = 0u, num_factors = 0u;
+  bool is_valid = read_uint(tokenizer, num_vars);
+  for (UInt iter = 0u; (iter < num_vars) && is_valid; iter++)
+  {
+    UInt cardinal = 0u;
+    is_valid = read_uint(tokenizer, cardinal) && (cardinal > 0u);
+    info.cardinals.push_back(cardinal);
+  }
+  is_valid = is_valid && read_uint(tokenizer, num_factors);
+
+  factors.clear();
+  for (UInt iter = 0u; (iter < num_factors) && is_valid; iter++)
+  {
+    UInt scope_size = 0u;
+    is_valid = read_uint(tokenizer, scope_size);
+    factors.push_back(factor());
+    for (UInt var_iter = 0u; (var_iter < scope_size) && is_valid; var_iter++)
+    {
+      UInt var = 0u;
+      is_valid = read_uint(tokenizer, var) && (var < num_vars);
+      if (is_valid == true)
+      {
+        factors[iter].variables.push_back(var);
+        factors[iter].cardinals.push_back(info.cardinals[var]);
+      }
+    }
+    std::reverse(factors[iter].variables.begin(), factors[iter].variables.end());
+    std::reverse(factors[iter].cardinals.begin(), factors[iter].cardinals.end());
+  }
+
+  for (UInt iter = 0u; (iter < num_factors) && is_valid; iter++)
+  {
+    // table size in 64 bits, cardinals are at least 1 so the product only stops early once it's too big
+    std::uint64_t table_size = 1u;
+    for (const UInt cardinal: factors[iter].cardinals)
+    {
+      if (table_size <= std::numeric_limits<UInt>::max())
+      {  table_size *= cardinal;  }
+    }
+
+    UInt num_values = 0u;
+    is_valid = read_uint(tokenizer, num_values) && (num_values == table_size);
+    for (UInt value_iter = 0u; (value_iter < num_values) && is_valid; value_iter++)
+    {
+      float value = 0.0f;
+      is_valid = read_float(tokenizer, value);
+      factors[iter].values.push_back(value);
+    }
+  }
+
+  if ((is_valid == false) || (tokenizer.is_malformed == true))
+  {
+    std::cout << file_path << ": malformed UAI network near '" << tokenizer.token << "'\n";
+    factors.clear();
+    return false;
+  }
+  return true;
+}
+
+
+bool load_uai_evidence(const std::string&          file_path,
+                             std::vector<UIntVec>& evidence)
+{
+  // "n var state var state ...", the older layout starts with the number of samples and only
+  // the first sample is read
+  fileTokenizer tokenizer;
+  if (open_tokenizer(file_path, tokenizer) == false)
+  {  return false;  }
+
+  UIntVec numbers;
+  UInt number = 0u;
+  while (read_uint(tokenizer, number) == true)
+  {  numbers.push_back(number);  }
+
+  evidence.clear();
+  if ((numbers.empty() == true) && (tokenizer.is_malformed == false))
+  {  return true;  }
+
+  // counts are compared in std::size_t against what is left, a huge count can't wrap the check
+  std::size_t first = 0u;
+  if ((numbers.size() >= 2u) && ((numbers.size() % 2u == 0u) || (numbers[0] != (numbers.size() - 1u)/2u)))
+  {  first = 1u;  }
+  if (   (tokenizer.is_malformed == true)
+      || (numbers.size() < first + 1u)
+      || (numbers[first] > (numbers.size() - first - 1u)/2u) )
+  {
+    std::cout << file_path << ": malformed UAI evidence\n";
+    return false;
+  }
+  for (UInt iter = 0u; iter < numbers[first]; iter++)
+  {  evidence.push_back(UIntVec{numbers[first + 1u + 2u*iter], numbers[first + 2u + 2u*iter]});  }
+  return true;
+}
+
+
+/* ---- BIF ---- */
+
+bool skip_statement(fileTokenizer& tokenizer)
+{
+  // everything up to and including the next ';' (property lines and the like)
+  while (next_token(tokenizer) == true)
+  {
+    if (token_is(tokenizer, ";") == true)
+    {  return true;  }
+  }
+  return false;
+}
+
+
+bool skip_block(fileTokenizer& tokenizer)
+{
+  // everything up to the '}' closing the block that was just opened
+  UInt depth = 1u;
+  while (next_token(tokenizer) == true)
+  {
+    if      (token_is(tokenizer, "{") == true)  {  depth++;  }
+    else if (token_is(tokenizer, "}") == true)  {  if (--depth == 0u) {  return true;  }  }
+  }
+  return false;
+}
+
+
+bool parse_bif_variable(fileTokenizer&                         tokenizer,
+                        networkFileInfo&                       info,
+                        std::unordered_map<std::string, UInt>& var_ids)
+{
+  // variable name { type discrete [ n ] { s0, s1, ... }; property ...; }
+  if (next_token(tokenizer) == false)
+  {  return false;  }
+  const UInt var = static_cast<UInt>(info.var_names.size());
+  info.var_names.push_back(std::string(tokenizer.token, tokenizer.token_length));
+  var_ids[info.var_names.back()] = var;
+  info.cardinals.push_back(0u);
+  info.state_names.push_back(std::vector<std::string>());
+
+  if (expect_token(tokenizer, "{") == false)
+  {  return false;  }
+
+  while (next_token(tokenizer) == true)
+  {
+    // a variable without a type line or with no states is malformed
+    if (token_is(tokenizer, "}") == true)
+    {  return (info.cardinals[var] > 0u) && (info.cardinals[var] == info.state_names[var].size());  }
+
+    if (token_is(tokenizer, "type") == false)
+    {
+      if (skip_statement(tokenizer) == false)
+      {  return false;  }
+      continue;
+    }
+
+    if (   (expect_token(tokenizer, "discrete") == false)
+        || (expect_token(tokenizer, "[") == false)
+        || (read_uint(tokenizer, info.cardinals[var]) == false)
+        || (expect_token(tokenizer, "]") == false)
+        || (expect_token(tokenizer, "{") == false) )
+    {  return false;  }
+
+    while (next_token(tokenizer) == true)
+    {
+      if (token_is(tokenizer, "}") == true)
+      {  break;  }
+      if (token_is(tokenizer, ",") == false)
+      {  info.state_names[var].push_back(std::string(tokenizer.token, tokenizer.token_length));  }
+    }
+    if (expect_token(tokenizer, ";") == false)
+    {  return false;  }
+  }
+  return false;
+}
+
+
+bool find_bif_state(const networkFileInfo& info,
+                    const UInt             var,
+                    const fileTokenizer&   tokenizer,
+                          UInt&            state)
+{
+  for (std::size_t iter = 0u; iter < info.state_names[var].size(); iter++)
+  {
+    if (info.state_names[var][iter] == tokenizer.token)
+    {
+      state = static_cast<UInt>(iter);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool parse_bif_probability(fileTokenizer&                               tokenizer,
+                           const networkFileInfo&                       info,
+                           const std::unordered_map<std::string, UInt>& var_ids,
+                                 factor&                                cpd)
+{
+  // probability ( child | parent1, parent2 ) { (p1_state, p2_state) v0, v1, ...; table ...; default ...; }
+  // factor scope is {child, parents...}
+  if (expect_token(tokenizer, "(") == false)
+  {  return false;  }
+
+  cpd = factor();
+  while (next_token(tokenizer) == true)
+  {
+    if (token_is(tokenizer, ")") == true)
+    {  break;  }
+    if ((token_is(tokenizer, "|") == true) || (token_is(tokenizer, ",") == true))
+    {  continue;  }
+
+    std::unordered_map<std::string, UInt>::const_iterator var = var_ids.find(std::string(tokenizer.token, tokenizer.token_length));
+    if (var == var_ids.end())
+    {  return false;  }
+    cpd.variables.push_back(var->second);
+    cpd.cardinals.push_back(info.cardinals[var->second]);
+  }
+  if ((cpd.variables.empty() == true) || (expect_token(tokenizer, "{") == false))
+  {  return false;  }
+
+  // table size in 64 bits, every cardinal is at least 1 so the product only stops early once it's too big
+  std::uint64_t table_size = 1u;
+  for (const UInt cardinal: cpd.cardinals)
+  {
+    if ((cardinal == 0u) || (table_size > LOADER_MAX_BIF_TABLE_SIZE))
+    {  return false;  }
+    table_size *= cardinal;
+  }
+  if (table_size > LOADER_MAX_BIF_TABLE_SIZE)
+  {  return false;  }
+
+  const UInt child_cardinal = cpd.cardinals[0];
+  const UInt num_rows       = static_cast<UInt>(table_size)/child_cardinal;
+  cpd.values.assign(num_rows*child_cardinal, 0.0f);
+  std::vector<bool> is_row_set(num_rows, false);
+  std::vector<float> default_row;
+
+  UIntVec strides;
+  get_strides(cpd, strides);
+
+  while (next_token(tokenizer) == true)
+  {
+    if (token_is(tokenizer, "}") == true)
+    {
+      // rows that weren't listed take the default entry
+      for (UInt row = 0u; (row < num_rows) && (default_row.size() == child_cardinal); row++)
+      {
+        if (is_row_set[row] == false)
+        {  std::copy(default_row.begin(), default_row.end(), cpd.values.begin() + row*child_cardinal);  }
+      }
+      return true;
+    }
+
+    if (token_is(tokenizer, "table") == true)
+    {
+      // child varies slowest and the last parent fastest
+      const UInt num_values = static_cast<UInt>(cpd.values.size());
+      for (UInt iter = 0u; iter < num_values; iter++)
+      {
+        float value = 0.0f;
+        if (read_float(tokenizer, value) == false)
+        {  return false;  }
+
+        UInt remainder = iter, index = 0u;
+        for (std::size_t var_iter = cpd.variables.size(); var_iter > 0u; var_iter--)
+        {
+          index     += (remainder % cpd.cardinals[var_iter - 1u])*strides[var_iter - 1u];
+          remainder /= cpd.cardinals[var_iter - 1u];
+        }
+        cpd.values[index] = value;
+        if ((iter + 1u < num_values) && (expect_token(tokenizer, ",") == false))
+        {  return false;  }
+      }
+      std::fill(is_row_set.begin(), is_row_set.end(), true);
+    }
+    else if ((token_is(tokenizer, "(") == true) || (token_is(tokenizer, "default") == true))
+    {
+      const bool is_default = token_is(tokenizer, "default");
+      UInt row = 0u;
+      if (is_default == false)
+      {
+        for (std::size_t var_iter = 1u; var_iter < cpd.variables.size(); var_iter++)
+        {
+          UInt state = 0u;
+          if (   ((var_iter > 1u) && (expect_token(tokenizer, ",") == false))
+              || (next_token(tokenizer) == false)
+              || (find_bif_state(info, cpd.variables[var_iter], tokenizer, state) == false) )
+          {  return false;  }
+          row += state*strides[var_iter]/child_cardinal;
+        }
+        if (expect_token(tokenizer, ")") == false)
+        {  return false;  }
+      }
+
+      std::vector<float> row_values(child_cardinal);
+      for (UInt state = 0u; state < child_cardinal; state++)
+      {
+        if (   (read_float(tokenizer, row_values[state]) == false)
+            || ((state + 1u < child_cardinal) && (expect_token(tokenizer, ",") == false)) )
+        {  return false;  }
+      }
+
+      if (is_default == true)
+      {  default_row = row_values;  }
+      else
+      {
+        std::copy(row_values.begin(), row_values.end(), cpd.values.begin() + row*child_cardinal);
+        is_row_set[row] = true;
+      }
+    }
+    else if (token_is(tokenizer, ";") == true)
+    {  continue;  }
+
+    if ((token_is(tokenizer, ";") == false) && (skip_statement(tokenizer) == false))
+    {  return false;  }
+  }
+  return false;
+}
+
+
+bool load_bif(const std::string&         file_path,
+                    std::vector<factor>& factors,
+                    networkFileInfo&     info)
+{
+  // variables get indices in the order they are declared, one factor per probability block
+  fileTokenizer tokenizer;
+  if (open_tokenizer(file_path, tokenizer) == false)
+  {  return false;  }
+
+  info = networkFileInfo();
+  factors.clear();
+  std::unordered_map<std::string, UInt> var_ids;
+
+  bool is_valid = true;
+  while (is_valid && (next_token(tokenizer) == true))
+  {
+    if (token_is(tokenizer, "network") == true)
+    {
+      is_valid = next_token(tokenizer) && expect_token(tokenizer, "{") && skip_block(tokenizer);
+    }
+    else if (token_is(tokenizer, "variable") == true)
+    {
+      is_valid = parse_bif_variable(tokenizer, info, var_ids);
+    }
+    else if (token_is(tokenizer, "probability") == true)
+    {
+      factors.push_back(factor());
+      is_valid = parse_bif_probability(tokenizer, info, var_ids, factors.back());
+    }
+    else
+    {
+      is_valid = false;
+    }
+  }
+
+  if ((is_valid == false) || (tokenizer.is_malformed == true))
+  {
+    std::cout << file_path << ": malformed BIF network near '" << tokenizer.token << "'\n";
+    factors.clear();
+    return false;
+  }
+  return true;
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef _BN_NOISY_MAX_H_
+#define _BN_NOISY_MAX_H_
+
+#include <iostream>
+#include <vector>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "util.h"
+
+namespace BN
+{
+
+// CPD where every parent independently pushes the child up to some level and the child takes the
+// largest one (noisy-OR is the binary case), parameters grow linearly with the number of parents
+struct noisyMaxCpd
+{
+  UInt    child;
+  UInt    child_cardinal;
+  UIntVec parents;
+  UIntVec parent_cardinals;
+
+  // per parent, distribution of the level it pushes the child to for each of its states,
+  // arranged as [parent_state*child_cardinal + child_state]
+  std::vector<std::vector<float>> link_probabilities;
+
+  // distribution of the level reached when no parent has any effect
+  std::vector<float> leak;
+};
+
+
+bool make_noisy_or(const UInt                child,
+                   const UIntVec&            parents,
+                   const std::vector<float>& inhibitor_probabilities,
+                   const float               leak_probability,
+                         noisyMaxCpd&        cpd)
+{
+  // binary child and parents, parent state 1 fails to turn the child on with its inhibitor probability,
+  // leak_probability is the chance the child is on with every parent off
+  cpd = noisyMaxCpd();
+  if (inhibitor_probabilities.size() != parents.size())
+  {
+    std::cout << "Cannot make noisy-OR, " << inhibitor_probabilities.size() << " inhibitor probabilities for "
+              << parents.size() << " parents\n";
+    return false;
+  }
+
+  cpd.child            = child;
+  cpd.child_cardinal   = 2u;
+  cpd.parents          = parents;
+  cpd.parent_cardinals = UIntVec(parents.size(), 2u);
+  cpd.leak             = std::vector<float>{1.0f - leak_probability, leak_probability};
+  for (const float inhibitor: inhibitor_probabilities)
+  {
+    cpd.link_probabilities.push_back(std::vector<float>{1.0f, 0.0f, inhibitor, 1.0f - inhibitor});
+  }
+  return true;
+}
+
+
+float link_cdf(const std::vector<float>& probabilities,
+               const UInt                offset,
+               const UInt                level)
+{
+  // probability of pushing the child to at most level
+  float result = 0.0f;
+  for (UInt iter = 0u; iter <= level; iter++)
+  {  result += probabilities[offset + iter];  }
+  return result;
+}
+
+
+float noisy_max_probability(const noisyMaxCpd& cpd,
+                            const UIntVec&     parent_states,
+                            const UInt         child_state)
+{
+  // P(child = state | parents) = P(child <= state | parents) - P(child <= state - 1 | parents)
+  float cdf_at_state = link_cdf(cpd.leak, 0u, child_state);
+  float cdf_below    = (child_state > 0u) ? link_cdf(cpd.leak, 0u, child_state - 1u) : 0.0f;
+  for (std::size_t iter = 0u; iter < cpd.parents.size(); iter++)
+  {
+    const UInt offset = parent_states[iter]*cpd.child_cardinal;
+    cdf_at_state *= link_cdf(cpd.link_probabilities[iter], offset, child_state);
+    if (child_state > 0u)
+    {  cdf_below *= link_cdf(cpd.link_probabilities[iter], offset, child_state - 1u);  }
+  }
+  return cdf_at_state - cdf_below;
+}
+
+
+void noisy_max_to_factor(const noisyMaxCpd& cpd,
+                               factor&      dense_factor)
+{
+  // full table over {child, parents...}, only meant for a handful of parents
+  dense_factor.variables = UIntVec{cpd.child};
+  dense_factor.variables.insert(dense_factor.variables.end(), cpd.parents.begin(), cpd.parents.end());
+  dense_factor.cardinals = UIntVec{cpd.child_cardinal};
+  dense_factor.cardinals.insert(dense_factor.cardinals.end(), cpd.parent_cardinals.begin(), cpd.parent_cardinals.end());
+  dense_factor.values.resize(util::vec_prod(dense_factor.cardinals));
+
+  UIntVec parent_states(cpd.parents.size(), 0u);
+  for (std::size_t iter = 0u; iter < dense_factor.values.size(); iter += cpd.child_cardinal)
+  {
+    for (UInt child_state = 0u; child_state < cpd.child_cardinal; child_state++)
+    {  dense_factor.values[iter + child_state] = noisy_max_probability(cpd, parent_states, child_state);  }
+
+    for (std::size_t var_iter = 0u; var_iter < parent_states.size(); var_iter++)
+    {
+      parent_states[var_iter]++;
+      if (parent_states[var_iter] < cpd.parent_cardinals[var_iter])
+      {  break;  }
+      parent_states[var_iter] = 0u;
+    }
+  }
+}
+
+
+void decompose_noisy_max(const noisyMaxCpd&         cpd,
+                         const UInt                 first_aux_var,
+                               std::vector<factor>& factors,
+                               UIntVec&             aux_vars)
+{
+  // temporal transform, the max is taken one parent at a time through a chain of auxiliary variables
+  //   Z_0 = max(leak, Y_0),  Z_i = max(Z_{i-1}, Y_i),  child = Z_{n-1}
+  // giving one {Z_0, X_0} factor and one {Z_i, Z_{i-1}, X_i} factor per remaining parent,
+  // every factor is a proper CPD so any inference routine can use them.
+  // auxiliary variables get the indices first_aux_var, first_aux_var + 1, ... (n - 1 of them)
+  factors.clear();
+  aux_vars.clear();
+  if (   (cpd.parent_cardinals.size()   != cpd.parents.size())
+      || (cpd.link_probabilities.size() != cpd.parents.size()) )
+  {
+    std::cout << "Cannot decompose noisy-MAX CPD, every parent needs a cardinal and link probabilities\n";
+    return;
+  }
+
+  const UInt num_parents = static_cast<UInt>(cpd.parents.size());
+  const UInt cardinal    = cpd.child_cardinal;
+  if (num_parents == 0u)
+  {
+    factors.push_back(factor());
+    factors.back().variables = UIntVec{cpd.child};
+    factors.back().cardinals = UIntVec{cardinal};
+    factors.back().values    = cpd.leak;
+    return;
+  }
+
+  for (UInt iter = 0u; iter + 1u < num_parents; iter++)
+  {  aux_vars.push_back(first_aux_var + iter);  }
+
+  // first parent together with the leak
+  factor first;
+  first.variables = UIntVec{(num_parents == 1u) ? cpd.child : aux_vars[0], cpd.parents[0]};
+  first.cardinals = UIntVec{cardinal, cpd.parent_cardinals[0]};
+  first.values.resize(cardinal*cpd.parent_cardinals[0]);
+  for (UInt parent_state = 0u; parent_state < cpd.parent_cardinals[0]; parent_state++)
+  {
+    float cdf_below = 0.0f;
+    for (UInt level = 0u; level < cardinal; level++)
+    {
+      const float cdf_at_level = link_cdf(cpd.leak, 0u, level)*link_cdf(cpd.link_probabilities[0], parent_state*cardinal, level);
+      first.values[parent_state*cardinal + level] = cdf_at_level - cdf_below;
+      cdf_below = cdf_at_level;
+    }
+  }
+  factors.push_back(std::move(first));
+
+  // P(Z_i = z | Z_{i-1} = z', x) is 0 below z', P(Y_i <= z' | x) at z' and P(Y_i = z | x) above it
+  for (UInt iter = 1u; iter < num_parents; iter++)
+  {
+    factor step;
+    step.variables = UIntVec{(iter + 1u == num_parents) ? cpd.child : aux_vars[iter], aux_vars[iter - 1u], cpd.parents[iter]};
+    step.cardinals = UIntVec{cardinal, cardinal, cpd.parent_cardinals[iter]};
+    step.values.assign(util::vec_prod(step.cardinals), 0.0f);
+
+    const std::vector<float>& link = cpd.link_probabilities[iter];
+    for (UInt parent_state = 0u; parent_state < cpd.parent_cardinals[iter]; parent_state++)
+    {
+      for (UInt previous = 0u; previous < cardinal; previous++)
+      {
+        const UInt base = (parent_state*cardinal + previous)*cardinal;
+        step.values[base + previous] = link_cdf(link, parent_state*cardinal, previous);
+        for (UInt level = previous + 1u; level < cardinal; level++)
+        {  step.values[base + level] = link[parent_state*cardinal + level];  }
+      }
+    }
+    factors.push_back(std::move(step));
+  }
+}
+
+} // end namespace {BN}
+
+#endif
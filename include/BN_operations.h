@@ -6,9 +6,11 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <limits>
 
 #include "BN_types.h"
 #include "util.h"
+#include "BN_simd.h"
 
 namespace BN
 {
@@ -107,47 +109,25 @@ void get_difference(const std::vector<UInt>& vec,
 
 void get_factor_union(const factor& factor1, 
                       const factor& factor2,
-                      const UIntVec& factor1_intersection,
                       const UIntVec& factor2_intersection,
                             factor& factor_union)
 {
-  std::vector<unsigned int> factor1_vars = factor1.variables;
-  std::vector<unsigned int> factor2_vars = factor2.variables;
+  // union keeps factor1 variables in their order followed by the factor2 only variables,
+  // so factor1 values stay contiguous in the union (leading strides are equal)
+  factor_union.variables.reserve(factor1.variables.size() + factor2.variables.size() - factor2_intersection.size());
+  factor_union.cardinals.reserve(factor1.variables.size() + factor2.variables.size() - factor2_intersection.size());
 
-  factor_union.variables.reserve(factor1_vars.size() + factor2_vars.size() - factor1_intersection.size());
-  factor_union.cardinals.reserve(factor1_vars.size() + factor2_vars.size() - factor1_intersection.size());
+  factor_union.variables.insert(factor_union.variables.end(), factor1.variables.begin(), factor1.variables.end());
+  factor_union.cardinals.insert(factor_union.cardinals.end(), factor1.cardinals.begin(), factor1.cardinals.end());
 
-  for (std::size_t iter1 = 0u; iter1 < factor1_intersection.size(); iter1++)
+  for (std::size_t iter = 0u; iter < factor2.variables.size(); iter++)
   {
-    unsigned int factor1_var = factor1.variables[factor1_intersection[iter1]];
-    unsigned int factor1_car = factor1.cardinals[factor1_intersection[iter1]];
-    
-    factor_union.variables.push_back(factor1_var);
-    factor_union.cardinals.push_back(factor1_car);
-
-    factor1_vars[factor1_intersection[iter1]] = 1000u;
-    factor2_vars[factor2_intersection[iter1]] = 1000u;
-  }
-
-  for (std::size_t iter = 0u; iter < factor1_vars.size(); iter++)
-  {
-    if (factor1_vars[iter] != 1000u)
-    {
-      factor_union.variables.push_back(factor1_vars[iter]);
-      factor_union.cardinals.push_back(factor1.cardinals[iter]);
-    }
-  }
-
-  for (std::size_t iter = 0u; iter < factor2_vars.size(); iter++)
-  {
-    if (factor2_vars[iter] != 1000u)
+    if (std::find(factor2_intersection.begin(), factor2_intersection.end(), iter) == factor2_intersection.end())
     {
-      factor_union.variables.push_back(factor2_vars[iter]);
+      factor_union.variables.push_back(factor2.variables[iter]);
       factor_union.cardinals.push_back(factor2.cardinals[iter]);
     }
   }
-  factor_union.variables.shrink_to_fit();
-  factor_union.cardinals.shrink_to_fit();
 }
 
 
@@ -200,6 +180,206 @@ int get_var_index(const factor& factor_to_find,
 }
 
 
+void get_strides(const factor& factor_to_calc, 
+                       UIntVec& strides)
+{
+  // stride of a variable is the distance (in values) between two consecutive states of it,
+  // first variable in the list changes the fastest
+  strides.resize(factor_to_calc.cardinals.size());
+  UInt stride = 1u;
+  for (std::size_t iter = 0u; iter < factor_to_calc.cardinals.size(); iter++)
+  {
+    strides[iter] = stride;
+    stride       *= factor_to_calc.cardinals[iter];
+  }
+}
+
+
+void get_strides_in_scope(const factor&  factor_to_calc, 
+                          const UIntVec& scope_vars,
+                                UIntVec& strides)
+{
+  // stride of each variable in scope_vars w.r.t factor_to_calc, 0 if the variable is not in the factor
+  UIntVec factor_strides;
+  get_strides(factor_to_calc, factor_strides);
+
+  strides.assign(scope_vars.size(), 0u);
+  for (std::size_t iter = 0u; iter < scope_vars.size(); iter++)
+  {
+    int var_index = get_var_index(factor_to_calc, scope_vars[iter]);
+    if (var_index != -1)
+    {
+      strides[iter] = factor_strides[var_index];
+    }
+  }
+}
+
+
+UInt get_inner_run(const UIntVec& cardinals,
+                   const UIntVec& strides_a,
+                   const UIntVec& strides_b,
+                         UInt&    run_length,
+                         UInt&    run_step_a,
+                         UInt&    run_step_b)
+{
+  // leading variables along which both tables are either contiguous (step 1) or constant (step 0)
+  // are flattened into a single run, otherwise the run is the first variable with its own strides.
+  // returns the number of variables covered by the run
+  run_length = cardinals[0];
+  run_step_a = strides_a[0];
+  run_step_b = strides_b[0];
+  if ((run_step_a > 1u) || (run_step_b > 1u))
+  {  return 1u;  }
+
+  UInt num_inner_vars = 1u;
+  while (   (num_inner_vars < cardinals.size())
+         && (strides_a[num_inner_vars] == run_step_a*run_length)
+         && (strides_b[num_inner_vars] == run_step_b*run_length) )
+  {
+    run_length *= cardinals[num_inner_vars];
+    num_inner_vars++;
+  }
+  return num_inner_vars;
+}
+
+
+void product_run(const float* left,  const UInt step_left,
+                 const float* right, const UInt step_right,
+                       float* result, const UInt run_length)
+{
+  const simdKernels& kernels = active_simd_kernels();
+  if ((step_left == 1u) && (step_right == 1u))
+  {  kernels.mul(left, right, result, run_length);  }
+  else if ((step_left == 1u) && (step_right == 0u))
+  {  kernels.mul_const(left, *right, result, run_length);  }
+  else if ((step_left == 0u) && (step_right == 1u))
+  {  kernels.mul_const(right, *left, result, run_length);  }
+  else
+  {
+    for (UInt state = 0u; state < run_length; state++)
+    {  result[state] = left[state*step_left]*right[state*step_right];  }
+  }
+}
+
+
+void sum_run(const float* source, const UInt step_source,
+                   float* result, const UInt step_result,
+             const UInt   run_length)
+{
+  const simdKernels& kernels = active_simd_kernels();
+  if ((step_source == 1u) && (step_result == 1u))
+  {  kernels.add(source, result, run_length);  }
+  else if ((step_source == 1u) && (step_result == 0u))
+  {  *result += kernels.sum(source, run_length);  }
+  else
+  {
+    for (UInt state = 0u; state < run_length; state++)
+    {  result[state*step_result] += source[state*step_source];  }
+  }
+}
+
+
+bool get_product_scope(const factor&  factor_left, 
+                       const factor&  factor_right,
+                             factor&  product_result,
+                             UIntVec& strides_left,
+                             UIntVec& strides_right)
+{
+  // sets up the (zeroed) product table for two non-empty factors and the stride of every product
+  // variable inside left and right factor, returns false if the shared cardinalities don't match
+  std::vector<UInt> intersection_indices_left, intersection_indices_right;
+  get_intersection(factor_left.variables, 
+                   factor_right.variables, 
+                   intersection_indices_left,
+                   intersection_indices_right);
+
+  // check if cardinalities matches for the intersection
+  for (std::size_t iter = 0; iter < intersection_indices_left.size(); iter++)
+  {
+    UInt factor_left_idx  = intersection_indices_left[iter];
+    UInt factor_right_idx = intersection_indices_right[iter];
+
+    if (factor_left.cardinals[factor_left_idx] != factor_right.cardinals[factor_right_idx])
+    {
+      std::cout << "Cardinals don't match, couldn't perform factor product\n";
+      return false;
+    }
+  }
+  
+  // vars of final operation is the union of A and B vars, 
+  // (empty intersection gives the outer product of both factors)
+  product_result.variables.clear();
+  product_result.cardinals.clear();
+  get_factor_union(factor_left, 
+                   factor_right, 
+                   intersection_indices_right,
+                   product_result);
+
+  product_result.values.assign(util::vec_prod(product_result.cardinals), 0.0F);
+
+  // stride of every product variable inside left and right factor (0 if variable is absent)
+  get_strides_in_scope(factor_left,  product_result.variables, strides_left);
+  get_strides_in_scope(factor_right, product_result.variables, strides_right);
+  return true;
+}
+
+
+void factor_product_range(const factor&     factor_left, 
+                          const factor&     factor_right,
+                          const UIntVec&    strides_left,
+                          const UIntVec&    strides_right,
+                                factor&     product_result,
+                          const std::size_t begin,
+                          const std::size_t end)
+{
+  // fills product values [begin, end), the range may start and end inside an inner run.
+  // walk the product table in order, leading variables form the inner (strided multiply) run
+  // while the remaining variables are advanced as an odometer
+  const std::size_t num_vars = product_result.variables.size();
+  UInt run_length, run_step_left, run_step_right;
+  const UInt num_inner_vars = get_inner_run(product_result.cardinals, strides_left, strides_right,
+                                            run_length, run_step_left, run_step_right);
+
+  // odometer state at begin
+  UIntVec assignment(num_vars, 0u);
+  UInt idx_left = 0u, idx_right = 0u;
+  std::size_t outer_index = begin/run_length;
+  for (std::size_t var_iter = num_inner_vars; var_iter < num_vars; var_iter++)
+  {
+    assignment[var_iter] = outer_index % product_result.cardinals[var_iter];
+    outer_index         /= product_result.cardinals[var_iter];
+    idx_left  += assignment[var_iter]*strides_left[var_iter];
+    idx_right += assignment[var_iter]*strides_right[var_iter];
+  }
+
+  // the flattened inner run has a constant step, so a partial run starts at inner_offset*step
+  UInt inner_offset = static_cast<UInt>(begin % run_length);
+  for (std::size_t iter_prod = begin; iter_prod < end; )
+  {
+    const UInt length = static_cast<UInt>(std::min<std::size_t>(run_length - inner_offset, end - iter_prod));
+    product_run(&factor_left.values[idx_left   + inner_offset*run_step_left],  run_step_left,
+                &factor_right.values[idx_right + inner_offset*run_step_right], run_step_right,
+                &product_result.values[iter_prod], length);
+    iter_prod   += length;
+    inner_offset = 0u;
+
+    for (std::size_t var_iter = num_inner_vars; var_iter < num_vars; var_iter++)
+    {
+      assignment[var_iter]++;
+      if (assignment[var_iter] < product_result.cardinals[var_iter])
+      {
+        idx_left  += strides_left[var_iter];
+        idx_right += strides_right[var_iter];
+        break;
+      }
+      assignment[var_iter] = 0u;
+      idx_left  -= (product_result.cardinals[var_iter] - 1u)*strides_left[var_iter];
+      idx_right -= (product_result.cardinals[var_iter] - 1u)*strides_right[var_iter];
+    }
+  }
+}
+
+
 void factor_product(const factor& factor_left, 
                     const factor& factor_right,
                           factor& product_result)
@@ -214,70 +394,81 @@ void factor_product(const factor& factor_left,
   {
     util::copy_factor(factor_left, product_result);
   }
-  else if (!factor_left_empty && !factor_right_empty)
+  else if (factor_left_empty && factor_right_empty)
   {
-    std::vector<UInt> intersection_indices_left, intersection_indices_right;
-    get_intersection(factor_left.variables, 
-                     factor_right.variables, 
-                     intersection_indices_left,
-                     intersection_indices_right);
+    // both are constants (all of their variables were summed out or observed)
+    util::copy_factor(factor_left.values.empty() ? factor_right : factor_left, product_result);
+    if (   (factor_left.values.empty()  == false)
+        && (factor_right.values.empty() == false) )
+    {  product_result.values[0] *= factor_right.values[0];  }
+  }
+  else
+  {
+    UIntVec strides_left, strides_right;
+    if (get_product_scope(factor_left, factor_right, product_result, strides_left, strides_right) == true)
+    {
+      factor_product_range(factor_left, factor_right, strides_left, strides_right, 
+                           product_result, 0u, product_result.values.size());
+    }
+  }
+}
+
 
-    if (intersection_indices_left.empty() == false)
+void factor_sum_out(const factor&  factor_to_sum,
+                    const UIntVec& sum_out_vars,
+                          factor&  sum_result)
+{
+  // result keeps the remaining variables in their original order,
+  // existing storage of sum_result is reused (assign doesn't release capacity)
+  sum_result.variables.clear();
+  sum_result.cardinals.clear();
+  for (std::size_t iter = 0u; iter < factor_to_sum.variables.size(); iter++)
+  {
+    if (std::find(sum_out_vars.begin(), sum_out_vars.end(), factor_to_sum.variables[iter]) == sum_out_vars.end())
     {
-      bool cardinals_match = true;
+      sum_result.variables.push_back(factor_to_sum.variables[iter]);
+      sum_result.cardinals.push_back(factor_to_sum.cardinals[iter]);
+    }
+  }
+  sum_result.values.assign(util::vec_prod(sum_result.cardinals), 0.0f);
 
-      // check if cardinalities matches for the intersection
-      for (std::size_t iter = 0; iter < intersection_indices_left.size(); iter++)
-      {
-        UInt factor_left_idx  = intersection_indices_left[iter];
-        UInt factor_right_idx = intersection_indices_right[iter];
+  if (factor_to_sum.variables.empty())
+  {
+    sum_result.values = factor_to_sum.values;
+    return;
+  }
 
-        if (factor_left.cardinals[factor_left_idx] != factor_right.cardinals[factor_right_idx])
-        {
-          cardinals_match = false;
-        }
-      }
-      if (cardinals_match == false)
-      {
-        std::cout << "Cardinals don't match, couldn't perform factor product\n";
-        return;
-      }
-      
-      // vars of final operation is the union of A and B vars
-      get_factor_union(factor_left, 
-                       factor_right, 
-                       intersection_indices_left,
-                       intersection_indices_right,
-                       product_result);
-
-      product_result.values = std::vector<float> (util::vec_prod(product_result.cardinals), 0.0F);
-
-      // now need to multiply factor together
-      std::vector<UIntVec> indices_left, indices_right, indices_prod;
-      
-      // take a sample matched variable index and get all the iterable index list
-      get_state_indices(factor_left,    intersection_indices_left[0],  indices_left);
-      get_state_indices(factor_right,   intersection_indices_right[0], indices_right);
-      
-      // assumes that first var in left and right matches with 1st var in product
-      get_state_indices(product_result, 0, indices_prod); 
-
-      // now do element wise product for each element in indices_left, indices_right;
-      UInt iter_prod;
-      for (std::size_t state = 0; state < indices_prod.size(); state++)
-      {
-        iter_prod = 0u;
-        for (std::size_t iter_right = 0; iter_right < indices_right[state].size(); iter_right++)
-        {
-          for (std::size_t iter_left = 0; iter_left < indices_left[state].size(); iter_left++)
-          {
-            product_result.values[indices_prod[state][iter_prod]] = factor_left.values[indices_left[state][iter_left]];
-            product_result.values[indices_prod[state][iter_prod]] *= factor_right.values[indices_right[state][iter_right]];
+  // stride of every source variable in the result (0 for the variables being summed out)
+  UIntVec strides_result;
+  get_strides_in_scope(sum_result, factor_to_sum.variables, strides_result);
 
-            ++iter_prod;
-          }
-        }
+  // single pass over the source table, each source value is accumulated into its result cell,
+  // leading variables form the inner run (source is always contiguous)
+  UIntVec strides_source;
+  get_strides(factor_to_sum, strides_source);
+
+  const std::size_t num_vars = factor_to_sum.variables.size();
+  UInt run_length, run_step_source, run_step_result;
+  const UInt num_inner_vars = get_inner_run(factor_to_sum.cardinals, strides_source, strides_result,
+                                            run_length, run_step_source, run_step_result);
+
+  UIntVec assignment(num_vars, 0u);
+  UInt idx_result = 0u;
+  for (std::size_t iter_source = 0u; iter_source < factor_to_sum.values.size(); iter_source += run_length)
+  {
+    sum_run(&factor_to_sum.values[iter_source], run_step_source,
+            &sum_result.values[idx_result],     run_step_result, run_length);
+
+    for (std::size_t var_iter = num_inner_vars; var_iter < num_vars; var_iter++)
+    {
+      assignment[var_iter]++;
+      if (assignment[var_iter] < factor_to_sum.cardinals[var_iter])
+      {
+        idx_result += strides_result[var_iter];
+        break;
       }
+      assignment[var_iter] = 0u;
+      idx_result -= (factor_to_sum.cardinals[var_iter] - 1u)*strides_result[var_iter];
     }
   }
 }
@@ -287,7 +478,6 @@ void factor_marginalize(const factor& factor_marginalize,
                         const UInt marginalize_var,
                               factor& marginal_result)
 {
-  std::vector<UIntVec> factor_indices;
   int var_index = get_var_index(factor_marginalize, 
                                 marginalize_var);
   if (var_index == -1)
@@ -297,35 +487,96 @@ void factor_marginalize(const factor& factor_marginalize,
   }
   else
   {
-    // copy variables over,
-    marginal_result.variables.reserve(factor_marginalize.variables.size()-1);
-    marginal_result.cardinals.reserve(factor_marginalize.cardinals.size()-1);
+    factor_sum_out(factor_marginalize, UIntVec{marginalize_var}, marginal_result);
+  }
+}
 
-    for (std::size_t source_iter = 0u; source_iter < factor_marginalize.variables.size(); source_iter++)
+
+void factor_max_out(const factor&  factor_to_max,
+                    const UIntVec& max_out_vars,
+                          factor&  max_result,
+                          UIntVec& argmax)
+{
+  // max-product counterpart of factor_sum_out, each result cell keeps the largest consistent source value,
+  // argmax[cell] is the maximizing assignment of the maxed out variables as a flat index
+  // (first of them fastest, in the order they appear in the source), ties keep the first one
+  max_result.variables.clear();
+  max_result.cardinals.clear();
+  UIntVec strides_max(factor_to_max.variables.size(), 0u);
+  UInt max_stride = 1u;
+  for (std::size_t iter = 0u; iter < factor_to_max.variables.size(); iter++)
+  {
+    if (std::find(max_out_vars.begin(), max_out_vars.end(), factor_to_max.variables[iter]) == max_out_vars.end())
     {
-      if (source_iter != var_index)
-      {
-        marginal_result.variables.push_back(factor_marginalize.variables[source_iter]);
-        marginal_result.cardinals.push_back(factor_marginalize.cardinals[source_iter]);
-      }
+      max_result.variables.push_back(factor_to_max.variables[iter]);
+      max_result.cardinals.push_back(factor_to_max.cardinals[iter]);
     }
-    marginal_result.values.reserve(util::vec_prod(marginal_result.cardinals));
+    else
+    {
+      strides_max[iter] = max_stride;
+      max_stride       *= factor_to_max.cardinals[iter];
+    }
+  }
+  max_result.values.assign(util::vec_prod(max_result.cardinals), -std::numeric_limits<float>::infinity());
+  argmax.assign(max_result.values.size(), 0u);
+
+  if (factor_to_max.variables.empty())
+  {
+    max_result.values = factor_to_max.values;
+    return;
+  }
 
-    get_state_indices(factor_marginalize, var_index, factor_indices);
-    UInt result_iter = 0u;
-    for (std::size_t iter    = 0u; iter < factor_indices[0u].size(); iter++)
+  UIntVec strides_result;
+  get_strides_in_scope(max_result, factor_to_max.variables, strides_result);
+
+  const std::size_t num_vars = factor_to_max.variables.size();
+  UIntVec assignment(num_vars, 0u);
+  UInt idx_result = 0u, idx_max = 0u;
+  for (std::size_t iter_source = 0u; iter_source < factor_to_max.values.size(); iter_source++)
+  {
+    if (factor_to_max.values[iter_source] > max_result.values[idx_result])
+    {
+      max_result.values[idx_result] = factor_to_max.values[iter_source];
+      argmax[idx_result]            = idx_max;
+    }
+
+    for (std::size_t var_iter = 0u; var_iter < num_vars; var_iter++)
     {
-      float result = 0.0f;
-      for (std::size_t state = 0u; state < factor_indices.size(); state++)
+      assignment[var_iter]++;
+      if (assignment[var_iter] < factor_to_max.cardinals[var_iter])
       {
-        result += factor_marginalize.values[factor_indices[state][iter]];
+        idx_result += strides_result[var_iter];
+        idx_max    += strides_max[var_iter];
+        break;
       }
-      marginal_result.values.push_back(result);
+      assignment[var_iter] = 0u;
+      idx_result -= (factor_to_max.cardinals[var_iter] - 1u)*strides_result[var_iter];
+      idx_max    -= (factor_to_max.cardinals[var_iter] - 1u)*strides_max[var_iter];
     }
   }
 }
 
 
+void factor_maximize(const factor&  factor_maximize,
+                     const UInt     maximize_var,
+                           factor&  max_result,
+                           UIntVec& argmax)
+{
+  // argmax[cell] is the best state of maximize_var for that assignment of the remaining variables
+  int var_index = get_var_index(factor_maximize,
+                                maximize_var);
+  if (var_index == -1)
+  {
+    std::cout << "given variable -> " << maximize_var << " not found\n";
+    std::cout << "passed factor is: \n" << factor_maximize << '\n';
+  }
+  else
+  {
+    factor_max_out(factor_maximize, UIntVec{maximize_var}, max_result, argmax);
+  }
+}
+
+
 void compute_joint(const std::vector<factor*>& factors_vec, 
                         factor& jpd_result)
 {
@@ -336,7 +587,7 @@ void compute_joint(const std::vector<factor*>& factors_vec,
     for (std::size_t iter = 2u; iter < factors_vec.size(); iter++)
     {
       factor_product(*factors_vec[iter], jpd_result, temp);
-      util::copy_factor(temp, jpd_result);
+      std::swap(temp, jpd_result);
     }
   }
   else if (factors_vec.size() == 1u)
@@ -388,10 +639,131 @@ void observe_evidence(const std::vector<UIntVec>& evidence,
 }
 
 
+void factor_reduce(const factor&                factor_to_reduce,
+                   const std::vector<UIntVec>&  evidence,
+                         factor&                reduced_result)
+{
+  // slice observed variables out of the factor, keeping only the values consistent with the evidence
+  reduced_result.variables.clear();
+  reduced_result.cardinals.clear();
+
+  UIntVec source_strides;
+  get_strides(factor_to_reduce, source_strides);
+
+  UIntVec kept_strides;
+  UInt base_index = 0u;
+  for (std::size_t var_iter = 0u; var_iter < factor_to_reduce.variables.size(); var_iter++)
+  {
+    bool is_observed = false;
+    for (const UIntVec& evidence_elem: evidence)
+    {
+      if (   (evidence_elem[0] == factor_to_reduce.variables[var_iter])
+          && (evidence_elem[1] <  factor_to_reduce.cardinals[var_iter]) )
+      {
+        base_index += evidence_elem[1]*source_strides[var_iter];
+        is_observed = true;
+        break;
+      }
+    }
+    if (is_observed == false)
+    {
+      reduced_result.variables.push_back(factor_to_reduce.variables[var_iter]);
+      reduced_result.cardinals.push_back(factor_to_reduce.cardinals[var_iter]);
+      kept_strides.push_back(source_strides[var_iter]);
+    }
+  }
+
+  reduced_result.values.resize(util::vec_prod(reduced_result.cardinals));
+  if (factor_to_reduce.values.empty() == true)
+  {
+    reduced_result.values.clear();
+    return;
+  }
+
+  // gather the consistent values, remaining variables are advanced as an odometer
+  const std::size_t num_vars = reduced_result.variables.size();
+  UIntVec assignment(num_vars, 0u);
+  UInt idx_source = base_index;
+  for (std::size_t iter_result = 0u; iter_result < reduced_result.values.size(); iter_result++)
+  {
+    reduced_result.values[iter_result] = factor_to_reduce.values[idx_source];
+
+    for (std::size_t var_iter = 0u; var_iter < num_vars; var_iter++)
+    {
+      assignment[var_iter]++;
+      if (assignment[var_iter] < reduced_result.cardinals[var_iter])
+      {
+        idx_source += kept_strides[var_iter];
+        break;
+      }
+      assignment[var_iter] = 0u;
+      idx_source -= (reduced_result.cardinals[var_iter] - 1u)*kept_strides[var_iter];
+    }
+  }
+}
+
+
+void reduce_evidence(const std::vector<UIntVec>&  evidence,
+                     const std::vector<factor*>&  factor_vec,
+                           std::vector<factor>&   reduced_factors)
+{
+  // factors left without any variable are constants, they only scale the result and are dropped
+  reduced_factors.clear();
+  reduced_factors.reserve(factor_vec.size());
+
+  factor reduced;
+  for (const factor* factor_ptr: factor_vec)
+  {
+    factor_reduce(*factor_ptr, evidence, reduced);
+    if (reduced.variables.empty() == false)
+    {  reduced_factors.push_back(std::move(reduced));  }
+  }
+}
+
+
+void add_observed_vars(const std::vector<UInt>&     marginal_vars,
+                       const std::vector<UIntVec>&  evidence,
+                       const std::vector<factor*>&  factor_vec,
+                             factor&                factor_marg)
+{
+  // query variables that were observed are put back into the result as a (one-hot) indicator
+  factor indicator, temp;
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    if (   (std::find(marginal_vars.begin(), marginal_vars.end(), evidence_elem[0]) == marginal_vars.end())
+        || (get_var_index(factor_marg, evidence_elem[0]) != -1) )
+    {  continue;  }
+
+    for (const factor* factor_ptr: factor_vec)
+    {
+      int var_index = get_var_index(*factor_ptr, evidence_elem[0]);
+      if (   (var_index != -1)
+          && (evidence_elem[1] < factor_ptr->cardinals[var_index]) )
+      {
+        indicator.variables = UIntVec{evidence_elem[0]};
+        indicator.cardinals = UIntVec{factor_ptr->cardinals[var_index]};
+        indicator.values.assign(factor_ptr->cardinals[var_index], 0.0f);
+        indicator.values[evidence_elem[1]] = 1.0f;
+
+        if (factor_marg.variables.empty() == true)
+        {  factor_marg = indicator;  }
+        else
+        {
+          factor_product(factor_marg, indicator, temp);
+          std::swap(factor_marg, temp);
+        }
+        break;
+      }
+    }
+  }
+}
+
+
 void factor_normalize(factor& factor_to_normalize)
 {
-  float probability_sum = util::vec_sum_n(factor_to_normalize.values, factor_to_normalize.values.size());
-  util::vec_divide_n(factor_to_normalize.values, probability_sum, factor_to_normalize.values.size());
+  const simdKernels& kernels = active_simd_kernels();
+  float probability_sum = kernels.sum(factor_to_normalize.values.data(), factor_to_normalize.values.size());
+  kernels.divide(factor_to_normalize.values.data(), probability_sum, factor_to_normalize.values.size());
 }
 
 
@@ -400,25 +772,28 @@ void compute_marginal(const std::vector<UInt>&     marginal_vars,
                       const std::vector<factor*>&  factor_vec,
                             factor&                factor_marg)
 {
-  compute_joint(factor_vec, factor_marg);
+  // observed variables are sliced out of every factor before any product is taken
+  std::vector<factor> reduced_factors;
+  reduce_evidence(evidence, factor_vec, reduced_factors);
+
+  std::vector<factor*> reduced_ref_vec;
+  reduced_ref_vec.reserve(reduced_factors.size());
+  for (factor& reduced: reduced_factors)
+  {  reduced_ref_vec.push_back(&reduced);  }
 
-  std::vector<factor*> factor_marg_ref_vec { &factor_marg};
-  observe_evidence(evidence, factor_marg_ref_vec);
+  // every variable can be observed, leaving nothing to multiply
+  factor jpd;
+  if (reduced_ref_vec.empty() == false)
+  {  compute_joint(reduced_ref_vec, jpd);  }
 
   UIntVec var_to_marginalize;
-  get_difference(factor_marg.variables, 
+  get_difference(jpd.variables, 
                  marginal_vars, 
                  var_to_marginalize);
   
-  factor temp;
-  for (const UInt& var: var_to_marginalize)
-  {
-    factor_marginalize(factor_marg, var, temp);
-    util::copy_factor(temp, factor_marg);
-  }
-  factor_marg.cardinals.shrink_to_fit();
-  factor_marg.variables.shrink_to_fit();
-  factor_marg.values.shrink_to_fit();
+  // all the variables are removed in a single pass over the joint
+  factor_sum_out(jpd, var_to_marginalize, factor_marg);
+  add_observed_vars(marginal_vars, evidence, factor_vec, factor_marg);
 
   factor_normalize(factor_marg);
 }
@@ -0,0 +1,218 @@
+#ifndef _BN_PARALLEL_H_
+#define _BN_PARALLEL_H_
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "Eigen/unsupported/Eigen/CXX11/ThreadPool"
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "util.h"
+
+namespace BN
+{
+
+// tables with fewer values than this stay on the calling thread
+const std::size_t DEFAULT_MIN_PARALLEL_SIZE = 1u << 18;
+
+// number of chunks each pool thread gets, more than one evens out uneven progress
+const std::size_t CHUNKS_PER_THREAD = 4u;
+
+
+template <typename Function>
+std::size_t run_chunks(Eigen::ThreadPool& pool,
+                       const std::size_t  num_units,
+                       const std::size_t  unit_size,
+                       const Function&    chunk_function)
+{
+  // splits [0, num_units) into contiguous chunks, chunk_function(begin, end) gets
+  // the bounds scaled by unit_size, returns the number of chunks once every chunk is done
+  const std::size_t num_chunks = std::max<std::size_t>(1u, std::min<std::size_t>(num_units, pool.NumThreads()*CHUNKS_PER_THREAD));
+  Eigen::Barrier barrier(static_cast<unsigned int>(num_chunks));
+  for (std::size_t chunk = 0u; chunk < num_chunks; chunk++)
+  {
+    const std::size_t begin = ( chunk       *num_units/num_chunks)*unit_size;
+    const std::size_t end   = ((chunk + 1u) *num_units/num_chunks)*unit_size;
+    pool.Schedule([&chunk_function, &barrier, begin, end]()
+    {
+      chunk_function(begin, end);
+      barrier.Notify();
+    });
+  }
+  barrier.Wait();
+  return num_chunks;
+}
+
+
+std::size_t factor_product_parallel(const factor&            factor_left,
+                                    const factor&            factor_right,
+                                          factor&            product_result,
+                                          Eigen::ThreadPool& pool,
+                                    const std::size_t        min_parallel_size = DEFAULT_MIN_PARALLEL_SIZE)
+{
+  // every product value is computed exactly as in factor_product, so the result
+  // doesn't depend on the number of threads. returns the number of chunks the table was split into
+  // (1 if it stayed on the calling thread)
+  if (factor_left.variables.empty() || factor_right.variables.empty())
+  {
+    factor_product(factor_left, factor_right, product_result);
+    return 1u;
+  }
+
+  UIntVec strides_left, strides_right;
+  if (get_product_scope(factor_left, factor_right, product_result, strides_left, strides_right) == false)
+  {  return 0u;  }
+
+  if (product_result.values.size() < min_parallel_size)
+  {
+    factor_product_range(factor_left, factor_right, strides_left, strides_right,
+                         product_result, 0u, product_result.values.size());
+    return 1u;
+  }
+
+  // plain element ranges, chunks may split inner runs so their number doesn't depend on the variable layout
+  return run_chunks(pool, product_result.values.size(), 1u,
+                    [&](const std::size_t begin, const std::size_t end)
+  {
+    factor_product_range(factor_left, factor_right, strides_left, strides_right, product_result, begin, end);
+  });
+}
+
+
+void factor_sum_out_range(const factor&     factor_to_sum,
+                          const UIntVec&    kept_strides,
+                          const UIntVec&    summed_cardinals,
+                          const UIntVec&    summed_strides,
+                                factor&     sum_result,
+                          const std::size_t begin,
+                          const std::size_t end)
+{
+  // computes result values [begin, end), each one is summed on its own over the summed variables
+  // (in a fixed order), leading summed variables that are contiguous in the source form one run
+  UInt run_length = 1u;
+  std::size_t num_inner_vars = 0u;
+  while (   (num_inner_vars < summed_strides.size())
+         && (summed_strides[num_inner_vars] == run_length) )
+  {
+    run_length *= summed_cardinals[num_inner_vars];
+    num_inner_vars++;
+  }
+  const std::size_t num_runs = util::vec_prod(summed_cardinals)/run_length;
+  const simdKernels& kernels = active_simd_kernels();
+
+  // odometer state of the result variables at begin
+  const std::size_t num_result_vars = sum_result.variables.size();
+  UIntVec result_assignment(num_result_vars, 0u);
+  UInt idx_base = 0u;
+  std::size_t result_index = begin;
+  for (std::size_t var_iter = 0u; var_iter < num_result_vars; var_iter++)
+  {
+    result_assignment[var_iter] = result_index % sum_result.cardinals[var_iter];
+    result_index               /= sum_result.cardinals[var_iter];
+    idx_base += result_assignment[var_iter]*kept_strides[var_iter];
+  }
+
+  UIntVec summed_assignment(summed_cardinals.size(), 0u);
+  for (std::size_t iter_result = begin; iter_result < end; iter_result++)
+  {
+    float total = 0.0f;
+    UInt idx_source = idx_base;
+    for (std::size_t run = 0u; run < num_runs; run++)
+    {
+      total += (run_length == 1u) ? factor_to_sum.values[idx_source]
+                                  : kernels.sum(&factor_to_sum.values[idx_source], run_length);
+
+      for (std::size_t var_iter = num_inner_vars; var_iter < summed_cardinals.size(); var_iter++)
+      {
+        summed_assignment[var_iter]++;
+        if (summed_assignment[var_iter] < summed_cardinals[var_iter])
+        {
+          idx_source += summed_strides[var_iter];
+          break;
+        }
+        summed_assignment[var_iter] = 0u;
+        idx_source -= (summed_cardinals[var_iter] - 1u)*summed_strides[var_iter];
+      }
+    }
+    sum_result.values[iter_result] = total;
+
+    for (std::size_t var_iter = 0u; var_iter < num_result_vars; var_iter++)
+    {
+      result_assignment[var_iter]++;
+      if (result_assignment[var_iter] < sum_result.cardinals[var_iter])
+      {
+        idx_base += kept_strides[var_iter];
+        break;
+      }
+      result_assignment[var_iter] = 0u;
+      idx_base -= (sum_result.cardinals[var_iter] - 1u)*kept_strides[var_iter];
+    }
+  }
+}
+
+
+void factor_sum_out_parallel(const factor&            factor_to_sum,
+                             const UIntVec&           sum_out_vars,
+                                   factor&            sum_result,
+                                   Eigen::ThreadPool& pool,
+                             const std::size_t        min_parallel_size = DEFAULT_MIN_PARALLEL_SIZE)
+{
+  if (   (factor_to_sum.values.size()    < min_parallel_size)
+      || (factor_to_sum.variables.empty() == true) )
+  {
+    factor_sum_out(factor_to_sum, sum_out_vars, sum_result);
+    return;
+  }
+
+  // split the source variables into the kept ones (result scope, in order) and the summed ones
+  UIntVec source_strides;
+  get_strides(factor_to_sum, source_strides);
+
+  UIntVec kept_strides, summed_cardinals, summed_strides;
+  sum_result.variables.clear();
+  sum_result.cardinals.clear();
+  for (std::size_t iter = 0u; iter < factor_to_sum.variables.size(); iter++)
+  {
+    if (std::find(sum_out_vars.begin(), sum_out_vars.end(), factor_to_sum.variables[iter]) == sum_out_vars.end())
+    {
+      sum_result.variables.push_back(factor_to_sum.variables[iter]);
+      sum_result.cardinals.push_back(factor_to_sum.cardinals[iter]);
+      kept_strides.push_back(source_strides[iter]);
+    }
+    else
+    {
+      summed_cardinals.push_back(factor_to_sum.cardinals[iter]);
+      summed_strides.push_back(source_strides[iter]);
+    }
+  }
+  sum_result.values.assign(util::vec_prod(sum_result.cardinals), 0.0f);
+
+  // result is split into chunks, every result value is written by exactly one chunk
+  // and summed in the same order for any number of threads
+  run_chunks(pool, sum_result.values.size(), 1u,
+             [&](const std::size_t begin, const std::size_t end)
+  {
+    factor_sum_out_range(factor_to_sum, kept_strides, summed_cardinals, summed_strides, sum_result, begin, end);
+  });
+}
+
+
+void factor_marginalize_parallel(const factor&            factor_marginalize,
+                                 const UInt               marginalize_var,
+                                       factor&            marginal_result,
+                                       Eigen::ThreadPool& pool,
+                                 const std::size_t        min_parallel_size = DEFAULT_MIN_PARALLEL_SIZE)
+{
+  if (get_var_index(factor_marginalize, marginalize_var) == -1)
+  {
+    std::cout << "given variable -> " << marginalize_var << " not found\n";
+    return;
+  }
+  factor_sum_out_parallel(factor_marginalize, UIntVec{marginalize_var}, marginal_result, pool, min_parallel_size);
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,454 @@
+#ifndef _BN_RECURSIVE_CONDITIONING_H_
+#define _BN_RECURSIVE_CONDITIONING_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iterator>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_variable_elimination.h"
+#include "util.h"
+
+namespace BN
+{
+
+// leaves hold one factor each, variable sets are sorted local variable ids.
+// cutset is what a node conditions on (at a leaf, its variables nobody above instantiated),
+// context is the part of the ancestors' cutsets the node depends on and indexes its cache
+struct dtreeNode
+{
+  int left        = -1;
+  int right       = -1;
+  int factor_id   = -1;
+
+  UIntVec variables;
+  UIntVec cutset;
+  UIntVec context;
+  UIntVec context_strides;
+
+  // cache entries are -1 until computed, empty if the node isn't cached
+  bool               is_cached = false;
+  std::vector<float> cache;
+};
+
+
+struct dtree
+{
+  std::vector<factor>  factors;
+  std::vector<UIntVec> factor_var_ids;
+  std::vector<UIntVec> factor_strides;
+
+  UIntVec              variables;
+  UIntVec              var_cardinals;
+  std::map<UInt, UInt> var_ids;
+
+  std::vector<dtreeNode> nodes;
+  int root = -1;
+};
+
+
+struct rcStats
+{
+  unsigned long long recursive_calls = 0u;
+  unsigned long long cache_hits      = 0u;
+
+  // nodes picked for caching and their total number of cache entries
+  std::size_t cached_nodes  = 0u;
+  std::size_t cache_entries = 0u;
+};
+
+
+int compose_dtree_nodes(      dtree&     tree,
+                        const int        left,
+                        const int        right)
+{
+  dtreeNode node;
+  node.left  = left;
+  node.right = right;
+  std::set_union(tree.nodes[left].variables.begin(),  tree.nodes[left].variables.end(),
+                 tree.nodes[right].variables.begin(), tree.nodes[right].variables.end(),
+                 std::back_inserter(node.variables));
+  tree.nodes.push_back(std::move(node));
+  return static_cast<int>(tree.nodes.size()) - 1;
+}
+
+
+int compose_dtree_nodes(      dtree&     tree,
+                        const UIntVec&   node_ids,
+                        const std::size_t begin,
+                        const std::size_t end)
+{
+  // balanced composition keeps the dtree shallow
+  if (end - begin == 1u)
+  {  return static_cast<int>(node_ids[begin]);  }
+  const std::size_t middle = begin + (end - begin)/2u;
+  const int left  = compose_dtree_nodes(tree, node_ids, begin,  middle);
+  const int right = compose_dtree_nodes(tree, node_ids, middle, end);
+  return compose_dtree_nodes(tree, left, right);
+}
+
+
+void set_cutsets(      dtree&   tree,
+                 const int      node_id,
+                 const UIntVec& acutset)
+{
+  // acutset is the union of the cutsets of all ancestors
+  dtreeNode& node = tree.nodes[node_id];
+  std::set_intersection(node.variables.begin(), node.variables.end(),
+                        acutset.begin(),        acutset.end(),
+                        std::back_inserter(node.context));
+  UInt stride = 1u;
+  for (const UInt var_id: node.context)
+  {
+    node.context_strides.push_back(stride);
+    stride *= tree.var_cardinals[var_id];
+  }
+
+  if (node.factor_id != -1)
+  {
+    std::set_difference(node.variables.begin(), node.variables.end(),
+                        acutset.begin(),        acutset.end(),
+                        std::back_inserter(node.cutset));
+    return;
+  }
+
+  UIntVec shared;
+  std::set_intersection(tree.nodes[node.left].variables.begin(),  tree.nodes[node.left].variables.end(),
+                        tree.nodes[node.right].variables.begin(), tree.nodes[node.right].variables.end(),
+                        std::back_inserter(shared));
+  std::set_difference(shared.begin(),  shared.end(),
+                      acutset.begin(), acutset.end(),
+                      std::back_inserter(node.cutset));
+
+  UIntVec child_acutset;
+  std::set_union(acutset.begin(),     acutset.end(),
+                 node.cutset.begin(), node.cutset.end(),
+                 std::back_inserter(child_acutset));
+  const int left = node.left, right = node.right;
+  set_cutsets(tree, left,  child_acutset);
+  set_cutsets(tree, right, child_acutset);
+}
+
+
+void build_dtree(const std::vector<factor*>&  factor_vec,
+                       dtree&                 tree,
+                 const elimination_heuristic  heuristic = MIN_FILL)
+{
+  // dtree from an elimination order, eliminating a variable composes every subtree that mentions it,
+  // whatever is left at the end is composed into the root
+  tree = dtree();
+  std::vector<factor*> factors_with_vars;
+  UIntVec subtrees;
+  for (factor* factor_ptr: factor_vec)
+  {
+    UIntVec var_ids, strides;
+    for (std::size_t iter = 0u; iter < factor_ptr->variables.size(); iter++)
+    {
+      std::map<UInt, UInt>::const_iterator existing = tree.var_ids.find(factor_ptr->variables[iter]);
+      if (existing == tree.var_ids.end())
+      {
+        const UInt var_id = static_cast<UInt>(tree.variables.size());
+        tree.var_ids[factor_ptr->variables[iter]] = var_id;
+        tree.variables.push_back(factor_ptr->variables[iter]);
+        tree.var_cardinals.push_back(factor_ptr->cardinals[iter]);
+        var_ids.push_back(var_id);
+      }
+      else
+      {  var_ids.push_back(existing->second);  }
+    }
+    get_strides(*factor_ptr, strides);
+
+    dtreeNode leaf;
+    leaf.factor_id = static_cast<int>(tree.factors.size());
+    leaf.variables = var_ids;
+    std::sort(leaf.variables.begin(), leaf.variables.end());
+    subtrees.push_back(static_cast<UInt>(tree.nodes.size()));
+    tree.nodes.push_back(std::move(leaf));
+
+    tree.factors.push_back(*factor_ptr);
+    tree.factor_var_ids.push_back(std::move(var_ids));
+    tree.factor_strides.push_back(std::move(strides));
+    if (factor_ptr->variables.empty() == false)
+    {  factors_with_vars.push_back(factor_ptr);  }
+  }
+  if (subtrees.empty() == true)
+  {  return;  }
+
+  elimination_stats stats;
+  get_elimination_order(factors_with_vars, tree.variables, heuristic, stats);
+  for (const UInt var: stats.elimination_order)
+  {
+    const UInt var_id = tree.var_ids[var];
+    UIntVec with_var, without_var;
+    for (const UInt node_id: subtrees)
+    {
+      const UIntVec& node_vars = tree.nodes[node_id].variables;
+      if (std::binary_search(node_vars.begin(), node_vars.end(), var_id) == true)
+      {  with_var.push_back(node_id);  }
+      else
+      {  without_var.push_back(node_id);  }
+    }
+    if (with_var.size() > 1u)
+    {  without_var.push_back(static_cast<UInt>(compose_dtree_nodes(tree, with_var, 0u, with_var.size())));  }
+    else
+    {  without_var.insert(without_var.end(), with_var.begin(), with_var.end());  }
+    subtrees = std::move(without_var);
+  }
+  tree.root = compose_dtree_nodes(tree, subtrees, 0u, subtrees.size());
+
+  set_cutsets(tree, tree.root, UIntVec());
+}
+
+
+double dtree_node_work(      dtree&               tree,
+                       const int                  node_id,
+                       const double               calls,
+                             std::vector<double>& node_calls,
+                             std::vector<double>& node_work)
+{
+  // calls into the node and recursive calls per call into the node, both without any cache
+  const dtreeNode& node = tree.nodes[node_id];
+  double cutset_size = 1.0;
+  for (const UInt var_id: node.cutset)
+  {  cutset_size *= tree.var_cardinals[var_id];  }
+
+  node_calls[node_id] = calls;
+  node_work[node_id]  = 1.0;
+  if (node.factor_id == -1)
+  {
+    node_work[node_id] += cutset_size*(  dtree_node_work(tree, node.left,  calls*cutset_size, node_calls, node_work)
+                                       + dtree_node_work(tree, node.right, calls*cutset_size, node_calls, node_work));
+  }
+  return node_work[node_id];
+}
+
+
+std::size_t set_cache_budget(      dtree&      tree,
+                             const std::size_t memory_budget)
+{
+  // memory_budget in bytes, 0 gives linear space. an internal node saves (calls - cache entries)*work
+  // recursive calls if cached, nodes are cached by saved calls per byte while they fit in the budget.
+  // savings are estimated as if no other node were cached. returns bytes taken by the caches
+  for (dtreeNode& node: tree.nodes)
+  {
+    node.is_cached = false;
+    node.cache.clear();
+    node.cache.shrink_to_fit();
+  }
+  if (tree.root == -1)
+  {  return 0u;  }
+
+  std::vector<double> node_calls(tree.nodes.size(), 0.0), node_work(tree.nodes.size(), 0.0);
+  dtree_node_work(tree, tree.root, 1.0, node_calls, node_work);
+
+  std::vector<std::pair<double, UInt>> candidates;
+  for (UInt node_id = 0u; node_id < tree.nodes.size(); node_id++)
+  {
+    const dtreeNode& node = tree.nodes[node_id];
+    double cache_size = 1.0;
+    for (const UInt var_id: node.context)
+    {  cache_size *= tree.var_cardinals[var_id];  }
+
+    if ((node.factor_id == -1) && (node_calls[node_id] > cache_size))
+    {
+      const double benefit = (node_calls[node_id] - cache_size)*node_work[node_id];
+      candidates.push_back(std::make_pair(benefit/(cache_size*sizeof(float)), node_id));
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const std::pair<double, UInt>& left, const std::pair<double, UInt>& right) {  return left.first > right.first;  });
+
+  std::size_t used = 0u;
+  for (const std::pair<double, UInt>& candidate: candidates)
+  {
+    dtreeNode& node = tree.nodes[candidate.second];
+    std::size_t cache_size = 1u;
+    for (const UInt var_id: node.context)
+    {  cache_size *= tree.var_cardinals[var_id];  }
+
+    if (used + cache_size*sizeof(float) <= memory_budget)
+    {
+      node.is_cached = true;
+      node.cache.resize(cache_size);
+      used += cache_size*sizeof(float);
+    }
+  }
+  return used;
+}
+
+
+float rc_node(      dtree&           tree,
+              const int              node_id,
+                    std::vector<int>& states,
+                    rcStats&         stats)
+{
+  // sum over the free cutset variables of the product of the children (the factor value at a leaf),
+  // every context variable is instantiated by the ancestors or the evidence
+  stats.recursive_calls++;
+  dtreeNode& node = tree.nodes[node_id];
+
+  UInt cache_index = 0u;
+  if (node.is_cached == true)
+  {
+    for (std::size_t iter = 0u; iter < node.context.size(); iter++)
+    {  cache_index += static_cast<UInt>(states[node.context[iter]])*node.context_strides[iter];  }
+    if (node.cache[cache_index] >= 0.0f)
+    {
+      stats.cache_hits++;
+      return node.cache[cache_index];
+    }
+  }
+
+  UIntVec free_vars;
+  for (const UInt var_id: node.cutset)
+  {
+    if (states[var_id] == -1)
+    {
+      free_vars.push_back(var_id);
+      states[var_id] = 0;
+    }
+  }
+
+  float result = 0.0f;
+  while (true)
+  {
+    if (node.factor_id != -1)
+    {
+      const factor&  leaf_factor = tree.factors[node.factor_id];
+      const UIntVec& var_ids     = tree.factor_var_ids[node.factor_id];
+      const UIntVec& strides     = tree.factor_strides[node.factor_id];
+      UInt index = 0u;
+      for (std::size_t iter = 0u; iter < var_ids.size(); iter++)
+      {  index += static_cast<UInt>(states[var_ids[iter]])*strides[iter];  }
+      // factors without values count as 1, as in factor_product
+      result += (leaf_factor.values.empty() == true) ? 1.0f : leaf_factor.values[index];
+    }
+    else
+    {
+      const float left_value = rc_node(tree, node.left, states, stats);
+      if (left_value != 0.0f)
+      {  result += left_value*rc_node(tree, node.right, states, stats);  }
+    }
+
+    // next instantiation of the free cutset variables, first variable fastest
+    std::size_t var_iter = 0u;
+    for (; var_iter < free_vars.size(); var_iter++)
+    {
+      states[free_vars[var_iter]]++;
+      if (static_cast<UInt>(states[free_vars[var_iter]]) < tree.var_cardinals[free_vars[var_iter]])
+      {  break;  }
+      states[free_vars[var_iter]] = 0;
+    }
+    if (var_iter == free_vars.size())
+    {  break;  }
+  }
+
+  for (const UInt var_id: free_vars)
+  {  states[var_id] = -1;  }
+
+  if (node.is_cached == true)
+  {  node.cache[cache_index] = result;  }
+  return result;
+}
+
+
+float rc_probability(const std::vector<UIntVec>& evidence,
+                           dtree&                tree,
+                           rcStats&              stats)
+{
+  // P(evidence), caches are cleared since their entries depend on the evidence
+  stats = rcStats();
+  if (tree.root == -1)
+  {  return 1.0f;  }
+
+  for (dtreeNode& node: tree.nodes)
+  {
+    if (node.is_cached == true)
+    {
+      std::fill(node.cache.begin(), node.cache.end(), -1.0f);
+      stats.cached_nodes++;
+      stats.cache_entries += node.cache.size();
+    }
+  }
+
+  std::vector<int> states(tree.variables.size(), -1);
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    std::map<UInt, UInt>::const_iterator var = tree.var_ids.find(evidence_elem[0]);
+    if ((var != tree.var_ids.end()) && (evidence_elem[1] < tree.var_cardinals[var->second]))
+    {  states[var->second] = static_cast<int>(evidence_elem[1]);  }
+  }
+  return rc_node(tree, tree.root, states, stats);
+}
+
+
+void compute_marginal_rc(const UInt                  marginal_var,
+                         const std::vector<UIntVec>& evidence,
+                               dtree&                tree,
+                               factor&               factor_marg,
+                               rcStats&              stats)
+{
+  // P(marginal_var = x, evidence) for every x, one rc pass per state, stats are summed over the passes
+  factor_marg.variables.clear();
+  factor_marg.cardinals.clear();
+  factor_marg.values.clear();
+  stats = rcStats();
+
+  std::map<UInt, UInt>::const_iterator var = tree.var_ids.find(marginal_var);
+  if (var == tree.var_ids.end())
+  {
+    std::cout << "Cannot compute marginal, variable " << marginal_var << " is not in the dtree\n";
+    return;
+  }
+
+  factor_marg.variables = UIntVec{marginal_var};
+  factor_marg.cardinals = UIntVec{tree.var_cardinals[var->second]};
+  factor_marg.values.assign(tree.var_cardinals[var->second], 0.0f);
+
+  std::vector<UIntVec> query_evidence;
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    if (evidence_elem[0] != marginal_var)
+    {  query_evidence.push_back(evidence_elem);  }
+    else if (evidence_elem[1] < factor_marg.values.size())
+    {
+      factor_marg.values[evidence_elem[1]] = 1.0f;
+      return;
+    }
+  }
+  query_evidence.push_back(UIntVec{marginal_var, 0u});
+
+  rcStats pass_stats;
+  for (UInt state = 0u; state < factor_marg.values.size(); state++)
+  {
+    query_evidence.back()[1] = state;
+    factor_marg.values[state] = rc_probability(query_evidence, tree, pass_stats);
+    stats.recursive_calls += pass_stats.recursive_calls;
+    stats.cache_hits      += pass_stats.cache_hits;
+    stats.cached_nodes     = pass_stats.cached_nodes;
+    stats.cache_entries    = pass_stats.cache_entries;
+  }
+  factor_normalize(factor_marg);
+}
+
+
+void compute_marginal_rc(const UInt                  marginal_var,
+                         const std::vector<UIntVec>& evidence,
+                         const std::vector<factor*>& factor_vec,
+                         const std::size_t           memory_budget,
+                               factor&               factor_marg)
+{
+  dtree tree;
+  build_dtree(factor_vec, tree);
+  set_cache_budget(tree, memory_budget);
+
+  rcStats stats;
+  compute_marginal_rc(marginal_var, evidence, tree, factor_marg, stats);
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef _BN_RELEVANCE_H_
+#define _BN_RELEVANCE_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_variable_elimination.h"
+#include "util.h"
+
+namespace BN
+{
+
+void get_parent_child_lists(const std::map<std::string, std::shared_ptr<networkNode>>& network,
+                                  std::map<UInt, UIntVec>&                             parents,
+                                  std::map<UInt, UIntVec>&                             children)
+{
+  // adjacency by node index, every node of the network gets an entry (possibly empty)
+  parents.clear();
+  children.clear();
+  for (const std::pair<const std::string, std::shared_ptr<networkNode>>& node: network)
+  {
+    parents[node.second->node_index];
+    children[node.second->node_index];
+  }
+  for (const std::pair<const std::string, std::shared_ptr<networkNode>>& node: network)
+  {
+    for (const std::shared_ptr<networkNode>& child: node.second->children)
+    {
+      children[node.second->node_index].push_back(child->node_index);
+      parents[child->node_index].push_back(node.second->node_index);
+    }
+  }
+}
+
+
+void bayes_ball(const std::map<UInt, UIntVec>& parents,
+                const std::map<UInt, UIntVec>& children,
+                const UIntVec&                 query_vars,
+                const UIntVec&                 evidence_vars,
+                      std::set<UInt>&          requisite_nodes,
+                      std::set<UInt>&          requisite_evidence)
+{
+  // Bayes-ball (Shachter 1998), balls start at the query nodes as if sent from a child,
+  //  - an unobserved node passes a ball from a child to its parents and children,
+  //    and a ball from a parent to its children only
+  //  - an observed node bounces a ball from a parent back to its parents and blocks balls from children
+  // nodes marked on top need their CPD (requisite_nodes), observed nodes that were visited
+  // are the only evidence that can change the answer (requisite_evidence).
+  // barren nodes and d-separated parts of the network are never marked on top
+  requisite_nodes.clear();
+  requisite_evidence.clear();
+
+  const std::set<UInt> observed(evidence_vars.begin(), evidence_vars.end());
+  std::set<UInt> marked_top, marked_bottom;
+
+  // {node, came from child}
+  std::vector<std::pair<UInt, bool>> schedule;
+  for (const UInt var: query_vars)
+  {  schedule.push_back(std::make_pair(var, true));  }
+
+  while (schedule.empty() == false)
+  {
+    const UInt node        = schedule.back().first;
+    const bool from_child  = schedule.back().second;
+    schedule.pop_back();
+
+    std::map<UInt, UIntVec>::const_iterator node_parents  = parents.find(node);
+    std::map<UInt, UIntVec>::const_iterator node_children = children.find(node);
+    if ((node_parents == parents.end()) || (node_children == children.end()))
+    {  continue;  }
+
+    const bool is_observed = observed.find(node) != observed.end();
+    if (is_observed == true)
+    {  requisite_evidence.insert(node);  }
+
+    const bool pass_up   = (is_observed == false) ? from_child : (from_child == false);
+    const bool pass_down = (is_observed == false);
+
+    if ((pass_up == true) && (marked_top.insert(node).second == true))
+    {
+      for (const UInt parent: node_parents->second)
+      {  schedule.push_back(std::make_pair(parent, true));  }
+    }
+    if ((pass_down == true) && (marked_bottom.insert(node).second == true))
+    {
+      for (const UInt child: node_children->second)
+      {  schedule.push_back(std::make_pair(child, false));  }
+    }
+  }
+  requisite_nodes = std::move(marked_top);
+}
+
+
+void get_relevant_factors(const std::map<std::string, std::shared_ptr<networkNode>>& network,
+                          const std::vector<UInt>&                                   marginal_vars,
+                          const std::vector<UIntVec>&                                evidence,
+                          const std::vector<factor*>&                                factor_vec,
+                                std::vector<factor*>&                                relevant_factors,
+                                std::vector<UIntVec>&                                relevant_evidence)
+{
+  // the CPD of a node is the factor whose first variable is the node (child first, then parents),
+  // factors of nodes that are not in the network are always kept
+  std::map<UInt, UIntVec> parents, children;
+  get_parent_child_lists(network, parents, children);
+
+  UIntVec evidence_vars;
+  for (const UIntVec& evidence_elem: evidence)
+  {  evidence_vars.push_back(evidence_elem[0]);  }
+
+  std::set<UInt> requisite_nodes, requisite_evidence;
+  bayes_ball(parents, children, marginal_vars, evidence_vars, requisite_nodes, requisite_evidence);
+
+  relevant_factors.clear();
+  for (factor* factor_ptr: factor_vec)
+  {
+    if (   (factor_ptr->variables.empty() == true)
+        || (parents.find(factor_ptr->variables[0]) == parents.end())
+        || (requisite_nodes.find(factor_ptr->variables[0]) != requisite_nodes.end()) )
+    {  relevant_factors.push_back(factor_ptr);  }
+  }
+
+  relevant_evidence.clear();
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    if (   (parents.find(evidence_elem[0]) == parents.end())
+        || (requisite_evidence.find(evidence_elem[0]) != requisite_evidence.end()) )
+    {  relevant_evidence.push_back(evidence_elem);  }
+  }
+}
+
+
+void compute_marginal_pruned(const std::vector<UInt>&                                   marginal_vars,
+                             const std::vector<UIntVec>&                                evidence,
+                             const std::map<std::string, std::shared_ptr<networkNode>>& network,
+                             const std::vector<factor*>&                                factor_vec,
+                                   factor&                                              factor_marg)
+{
+  // only the factors Bayes-ball marks as requisite reach variable elimination
+  std::vector<factor*> relevant_factors;
+  std::vector<UIntVec> relevant_evidence;
+  get_relevant_factors(network, marginal_vars, evidence, factor_vec, relevant_factors, relevant_evidence);
+
+  // observed query variables don't need their CPD, they are added back as indicators
+  UIntVec unobserved_marginal_vars;
+  for (const UInt var: marginal_vars)
+  {
+    if (std::find_if(evidence.begin(), evidence.end(),
+                     [var](const UIntVec& evidence_elem) {  return evidence_elem[0] == var;  }) == evidence.end())
+    {  unobserved_marginal_vars.push_back(var);  }
+  }
+
+  factor_marg = factor();
+  if (unobserved_marginal_vars.empty() == false)
+  {  compute_marginal_ve(unobserved_marginal_vars, relevant_evidence, relevant_factors, factor_marg);  }
+
+  add_observed_vars(marginal_vars, evidence, factor_vec, factor_marg);
+  factor_normalize(factor_marg);
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,415 @@
+#ifndef _BN_SAMPLING_H_
+#define _BN_SAMPLING_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_parallel.h"
+#include "util.h"
+
+namespace BN
+{
+
+// weights are summed per block of this many samples and the blocks are added in order,
+// so estimates don't depend on how the samples were split across threads
+const std::size_t SAMPLE_BLOCK_SIZE = 4096u;
+
+// samples drawn together, one variable at a time
+const std::size_t SAMPLE_TILE_SIZE = 256u;
+
+
+// Walker alias tables for every row (parent configuration) of a CPD, row r covers
+// [r*cardinal, (r+1)*cardinal) of probabilities and aliases
+struct aliasTable
+{
+  UInt               cardinal = 0u;
+  std::vector<float> probabilities;
+  UIntVec            aliases;
+};
+
+
+// CPDs (child first, then parents) in topological order, ready for ancestral sampling
+struct samplingNetwork
+{
+  // child variable of each CPD in sampling order, and the position of a variable in that order
+  UIntVec              variables;
+  UIntVec              cardinals;
+  std::map<UInt, UInt> var_positions;
+
+  // per CPD: row normalized table, positions of the parents and their stride in rows
+  std::vector<factor>     cpds;
+  std::vector<UIntVec>    parent_positions;
+  std::vector<UIntVec>    parent_row_strides;
+  std::vector<aliasTable> alias_tables;
+};
+
+
+// samples stored one array per variable (structure of arrays), states[position][sample]
+struct sampleSet
+{
+  std::size_t          num_samples = 0u;
+  std::vector<UIntVec> states;
+  std::vector<float>   weights;
+};
+
+
+void build_alias_row(const float* row,
+                     const UInt   cardinal,
+                           float* probabilities,
+                           UInt*  aliases)
+{
+  // Vose's method, each cell keeps its own state with probabilities[i] and gives aliases[i] otherwise
+  UIntVec small, large;
+  std::vector<float> scaled(cardinal);
+  for (UInt state = 0u; state < cardinal; state++)
+  {
+    scaled[state] = row[state]*cardinal;
+    aliases[state] = state;
+    if (scaled[state] < 1.0f)
+    {  small.push_back(state);  }
+    else
+    {  large.push_back(state);  }
+  }
+
+  while ((small.empty() == false) && (large.empty() == false))
+  {
+    const UInt less = small.back();
+    const UInt more = large.back();
+    small.pop_back();
+    probabilities[less] = scaled[less];
+    aliases[less]       = more;
+    scaled[more]        = (scaled[more] + scaled[less]) - 1.0f;
+    if (scaled[more] < 1.0f)
+    {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+
+  // what is left is 1 up to rounding
+  for (const UInt state: small)  {  probabilities[state] = 1.0f;  }
+  for (const UInt state: large)  {  probabilities[state] = 1.0f;  }
+}
+
+
+bool build_sampling_network(const std::vector<factor*>& cpd_vec,
+                                  samplingNetwork&      network)
+{
+  // every CPD is a factor over {child, parents...}, every parent needs its own CPD,
+  // returns false if a parent has no CPD or the CPDs form a cycle
+  network = samplingNetwork();
+  std::map<UInt, std::size_t> cpd_of_var;
+  for (std::size_t iter = 0u; iter < cpd_vec.size(); iter++)
+  {
+    if (cpd_vec[iter]->variables.empty() == false)
+    {  cpd_of_var[cpd_vec[iter]->variables[0]] = iter;  }
+  }
+
+  // Kahn's algorithm over the CPDs
+  std::map<UInt, UInt> num_unplaced_parents;
+  std::map<UInt, UIntVec> children;
+  UIntVec order;
+  for (const std::pair<const UInt, std::size_t>& var_cpd: cpd_of_var)
+  {
+    const factor& cpd = *cpd_vec[var_cpd.second];
+    num_unplaced_parents[var_cpd.first] = static_cast<UInt>(cpd.variables.size() - 1u);
+    for (std::size_t iter = 1u; iter < cpd.variables.size(); iter++)
+    {
+      if (cpd_of_var.find(cpd.variables[iter]) == cpd_of_var.end())
+      {
+        std::cout << "variable " << cpd.variables[iter] << " has no CPD, couldn't build sampling network\n";
+        return false;
+      }
+      children[cpd.variables[iter]].push_back(var_cpd.first);
+    }
+    if (cpd.variables.size() == 1u)
+    {  order.push_back(var_cpd.first);  }
+  }
+  for (std::size_t head = 0u; head < order.size(); head++)
+  {
+    for (const UInt child: children[order[head]])
+    {
+      if (--num_unplaced_parents[child] == 0u)
+      {  order.push_back(child);  }
+    }
+  }
+  if (order.size() != cpd_of_var.size())
+  {
+    std::cout << "CPDs form a cycle, couldn't build sampling network\n";
+    return false;
+  }
+
+  for (const UInt var: order)
+  {
+    network.var_positions[var] = static_cast<UInt>(network.variables.size());
+    network.variables.push_back(var);
+    network.cardinals.push_back(cpd_vec[cpd_of_var[var]]->cardinals[0]);
+  }
+
+  for (const UInt var: order)
+  {
+    factor cpd = *cpd_vec[cpd_of_var[var]];
+    const UInt cardinal = cpd.cardinals[0];
+    const std::size_t num_rows = cpd.values.size()/cardinal;
+
+    // rows are normalized here, a row of zeros becomes uniform
+    for (std::size_t row = 0u; row < num_rows; row++)
+    {
+      float total = 0.0f;
+      for (UInt state = 0u; state < cardinal; state++)
+      {  total += cpd.values[row*cardinal + state];  }
+      for (UInt state = 0u; state < cardinal; state++)
+      {
+        float& value = cpd.values[row*cardinal + state];
+        value = (total > 0.0f) ? value/total : 1.0f/cardinal;
+      }
+    }
+
+    UIntVec positions, row_strides;
+    UInt row_stride = 1u;
+    for (std::size_t iter = 1u; iter < cpd.variables.size(); iter++)
+    {
+      positions.push_back(network.var_positions[cpd.variables[iter]]);
+      row_strides.push_back(row_stride);
+      row_stride *= cpd.cardinals[iter];
+    }
+
+    aliasTable table;
+    table.cardinal = cardinal;
+    table.probabilities.resize(cpd.values.size());
+    table.aliases.resize(cpd.values.size());
+    for (std::size_t row = 0u; row < num_rows; row++)
+    {
+      build_alias_row(&cpd.values[row*cardinal], cardinal,
+                      &table.probabilities[row*cardinal], &table.aliases[row*cardinal]);
+    }
+
+    network.cpds.push_back(std::move(cpd));
+    network.parent_positions.push_back(std::move(positions));
+    network.parent_row_strides.push_back(std::move(row_strides));
+    network.alias_tables.push_back(std::move(table));
+  }
+  return true;
+}
+
+
+void philox_4x32(const std::uint32_t counter[4],
+                 const std::uint64_t seed,
+                       std::uint32_t result[4])
+{
+  // Philox4x32-10 (Salmon et al. 2011), the output only depends on (counter, seed),
+  // so any sample can be drawn on any thread in any order
+  std::uint32_t key0 = static_cast<std::uint32_t>(seed);
+  std::uint32_t key1 = static_cast<std::uint32_t>(seed >> 32);
+  for (UInt iter = 0u; iter < 4u; iter++)
+  {  result[iter] = counter[iter];  }
+
+  for (UInt round = 0u; round < 10u; round++)
+  {
+    const std::uint64_t product0 = static_cast<std::uint64_t>(0xD2511F53u)*result[0];
+    const std::uint64_t product1 = static_cast<std::uint64_t>(0xCD9E8D57u)*result[2];
+    const std::uint32_t next0 = static_cast<std::uint32_t>(product1 >> 32) ^ result[1] ^ key0;
+    const std::uint32_t next2 = static_cast<std::uint32_t>(product0 >> 32) ^ result[3] ^ key1;
+    result[1] = static_cast<std::uint32_t>(product1);
+    result[3] = static_cast<std::uint32_t>(product0);
+    result[0] = next0;
+    result[2] = next2;
+    key0 += 0x9E3779B9u;
+    key1 += 0xBB67AE85u;
+  }
+}
+
+
+void draw_samples(const samplingNetwork&  network,
+                  const std::vector<int>& observed_states,
+                  const std::uint64_t     seed,
+                        sampleSet&        samples,
+                  const std::size_t       begin,
+                  const std::size_t       end)
+{
+  // samples [begin, end) in tiles, variable by variable (topological order) within a tile so every
+  // pass reads and writes contiguous state arrays. the random words of sample s come from the counter
+  // {s, s >> 32, block of 4 variables, 0}. observed variables are set to their state and scale the weight
+  // by their probability given the sampled parents (likelihood weighting)
+  const std::size_t num_vars = network.variables.size();
+  std::vector<std::uint32_t> random_words(4u*SAMPLE_TILE_SIZE);
+  UIntVec rows(SAMPLE_TILE_SIZE);
+  std::uint32_t counter[4];
+  counter[3] = 0u;
+
+  for (std::size_t tile_begin = begin; tile_begin < end; tile_begin += SAMPLE_TILE_SIZE)
+  {
+    const std::size_t tile_size = std::min(SAMPLE_TILE_SIZE, end - tile_begin);
+    float* weights = &samples.weights[tile_begin];
+    std::fill(weights, weights + tile_size, 1.0f);
+
+    for (std::size_t position = 0u; position < num_vars; position++)
+    {
+      std::fill(rows.begin(), rows.begin() + tile_size, 0u);
+      for (std::size_t iter = 0u; iter < network.parent_positions[position].size(); iter++)
+      {
+        const UInt* parent_states = &samples.states[network.parent_positions[position][iter]][tile_begin];
+        const UInt  row_stride    = network.parent_row_strides[position][iter];
+        for (std::size_t sample = 0u; sample < tile_size; sample++)
+        {  rows[sample] += parent_states[sample]*row_stride;  }
+      }
+
+      // words are drawn for observed variables too, the counter of a variable never changes
+      if (position % 4u == 0u)
+      {
+        counter[2] = static_cast<std::uint32_t>(position/4u);
+        for (std::size_t sample = 0u; sample < tile_size; sample++)
+        {
+          counter[0] = static_cast<std::uint32_t>(tile_begin + sample);
+          counter[1] = static_cast<std::uint32_t>(static_cast<std::uint64_t>(tile_begin + sample) >> 32);
+          philox_4x32(counter, seed, &random_words[4u*sample]);
+        }
+      }
+
+      const aliasTable& table  = network.alias_tables[position];
+      UInt*             states = &samples.states[position][tile_begin];
+      if (observed_states[position] != -1)
+      {
+        const UInt observed = static_cast<UInt>(observed_states[position]);
+        const float* values = network.cpds[position].values.data();
+        for (std::size_t sample = 0u; sample < tile_size; sample++)
+        {
+          states[sample]   = observed;
+          weights[sample] *= values[rows[sample]*table.cardinal + observed];
+        }
+        continue;
+      }
+
+      // top 24 bits as a uniform in [0, cardinal), the integer part picks the cell, the fraction the side
+      const float scale = table.cardinal*(1.0f/16777216.0f);
+      for (std::size_t sample = 0u; sample < tile_size; sample++)
+      {
+        const float scaled = static_cast<float>(random_words[4u*sample + position % 4u] >> 8)*scale;
+        const UInt cell = std::min(static_cast<UInt>(scaled), table.cardinal - 1u);
+        const std::size_t index = rows[sample]*table.cardinal + cell;
+        states[sample] = (scaled - cell < table.probabilities[index]) ? cell : table.aliases[index];
+      }
+    }
+  }
+}
+
+
+void likelihood_weighting(const samplingNetwork&      network,
+                          const std::vector<UIntVec>& evidence,
+                          const std::size_t           num_samples,
+                          const std::uint64_t         seed,
+                                sampleSet&            samples,
+                                Eigen::ThreadPool*    pool)
+{
+  // ancestral sampling with the observed variables clamped, without evidence every weight is 1.
+  // sample s is the same for every thread count (and with or without a pool)
+  std::vector<int> observed_states(network.variables.size(), -1);
+  for (const UIntVec& evidence_elem: evidence)
+  {
+    std::map<UInt, UInt>::const_iterator position = network.var_positions.find(evidence_elem[0]);
+    if ((position != network.var_positions.end()) && (evidence_elem[1] < network.cardinals[position->second]))
+    {  observed_states[position->second] = static_cast<int>(evidence_elem[1]);  }
+  }
+
+  samples.num_samples = num_samples;
+  samples.states.resize(network.variables.size());
+  for (UIntVec& var_states: samples.states)
+  {  var_states.resize(num_samples);  }
+  samples.weights.resize(num_samples);
+
+  if (pool != nullptr)
+  {
+    run_chunks(*pool, num_samples, 1u, [&](const std::size_t begin, const std::size_t end)
+    {
+      draw_samples(network, observed_states, seed, samples, begin, end);
+    });
+  }
+  else
+  {  draw_samples(network, observed_states, seed, samples, 0u, num_samples);  }
+}
+
+
+void estimate_marginal(const samplingNetwork&   network,
+                       const sampleSet&         samples,
+                       const std::vector<UInt>& marginal_vars,
+                             factor&            factor_marg,
+                             Eigen::ThreadPool* pool)
+{
+  // weighted histogram over the joint states of marginal_vars, normalized,
+  // per block sums are added in block order so the estimate is the same for any thread count
+  factor_marg = factor();
+  UIntVec positions;
+  for (const UInt var: marginal_vars)
+  {
+    std::map<UInt, UInt>::const_iterator position = network.var_positions.find(var);
+    if (position == network.var_positions.end())
+    {
+      std::cout << "given variable -> " << var << " is not in the sampling network\n";
+      return;
+    }
+    positions.push_back(position->second);
+    factor_marg.variables.push_back(var);
+    factor_marg.cardinals.push_back(network.cardinals[position->second]);
+  }
+
+  UIntVec strides;
+  get_strides(factor_marg, strides);
+  const std::size_t num_values = util::vec_prod(factor_marg.cardinals);
+  const std::size_t num_blocks = (samples.num_samples + SAMPLE_BLOCK_SIZE - 1u)/SAMPLE_BLOCK_SIZE;
+  std::vector<float> block_sums(num_blocks*num_values, 0.0f);
+
+  auto sum_blocks = [&](const std::size_t begin, const std::size_t end)
+  {
+    for (std::size_t block = begin; block < end; block++)
+    {
+      float* block_sum = &block_sums[block*num_values];
+      const std::size_t sample_end = std::min(samples.num_samples, (block + 1u)*SAMPLE_BLOCK_SIZE);
+      for (std::size_t sample = block*SAMPLE_BLOCK_SIZE; sample < sample_end; sample++)
+      {
+        std::size_t index = 0u;
+        for (std::size_t iter = 0u; iter < positions.size(); iter++)
+        {  index += samples.states[positions[iter]][sample]*strides[iter];  }
+        block_sum[index] += samples.weights[sample];
+      }
+    }
+  };
+  if (pool != nullptr)
+  {  run_chunks(*pool, num_blocks, 1u, sum_blocks);  }
+  else
+  {  sum_blocks(0u, num_blocks);  }
+
+  factor_marg.values.assign(num_values, 0.0f);
+  for (std::size_t block = 0u; block < num_blocks; block++)
+  {
+    for (std::size_t iter = 0u; iter < num_values; iter++)
+    {  factor_marg.values[iter] += block_sums[block*num_values + iter];  }
+  }
+  factor_normalize(factor_marg);
+}
+
+
+void compute_marginal_lw(const std::vector<UInt>&     marginal_vars,
+                         const std::vector<UIntVec>&  evidence,
+                         const std::vector<factor*>&  cpd_vec,
+                         const std::size_t            num_samples,
+                         const std::uint64_t          seed,
+                               Eigen::ThreadPool&     pool,
+                               factor&                factor_marg)
+{
+  samplingNetwork network;
+  if (build_sampling_network(cpd_vec, network) == false)
+  {  return;  }
+
+  sampleSet samples;
+  likelihood_weighting(network, evidence, num_samples, seed, samples, &pool);
+  estimate_marginal(network, samples, marginal_vars, factor_marg, &pool);
+}
+
+} // end namespace {BN}
+
+#endif
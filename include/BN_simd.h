@@ -0,0 +1,261 @@
+#ifndef _BN_SIMD_H_
+#define _BN_SIMD_H_
+
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+
+// SIMD kernels are compiled per function with target attributes (no global -mavx2 needed)
+// and picked at run time from the CPU features, other compilers/targets get the scalar kernels
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #define BN_SIMD_X86 1
+  #include <immintrin.h>
+#else
+  #define BN_SIMD_X86 0
+#endif
+
+namespace BN
+{
+
+enum simd_level
+{
+  SIMD_SCALAR = 0,
+  SIMD_AVX2   = 1,
+  SIMD_AVX512 = 2
+};
+
+
+/* ---- scalar kernels ---- */
+
+void simd_mul_scalar(const float* left, const float* right, float* result, const std::size_t num_elems)
+{
+  for (std::size_t iter = 0u; iter < num_elems; iter++)
+  {  result[iter] = left[iter]*right[iter];  }
+}
+
+void simd_mul_const_scalar(const float* left, const float constant, float* result, const std::size_t num_elems)
+{
+  for (std::size_t iter = 0u; iter < num_elems; iter++)
+  {  result[iter] = left[iter]*constant;  }
+}
+
+void simd_add_scalar(const float* source, float* result, const std::size_t num_elems)
+{
+  for (std::size_t iter = 0u; iter < num_elems; iter++)
+  {  result[iter] += source[iter];  }
+}
+
+float simd_sum_scalar(const float* source, const std::size_t num_elems)
+{
+  float result = 0.0f;
+  for (std::size_t iter = 0u; iter < num_elems; iter++)
+  {  result += source[iter];  }
+  return result;
+}
+
+void simd_divide_scalar(float* values, const float constant, const std::size_t num_elems)
+{
+  for (std::size_t iter = 0u; iter < num_elems; iter++)
+  {  values[iter] /= constant;  }
+}
+
+
+#if BN_SIMD_X86
+
+/* ---- AVX2 kernels, 8 floats per step ---- */
+
+__attribute__((target("avx2")))
+void simd_mul_avx2(const float* left, const float* right, float* result, const std::size_t num_elems)
+{
+  std::size_t iter = 0u;
+  for (; iter + 8u <= num_elems; iter += 8u)
+  {  _mm256_storeu_ps(result + iter, _mm256_mul_ps(_mm256_loadu_ps(left + iter), _mm256_loadu_ps(right + iter)));  }
+  simd_mul_scalar(left + iter, right + iter, result + iter, num_elems - iter);
+}
+
+__attribute__((target("avx2")))
+void simd_mul_const_avx2(const float* left, const float constant, float* result, const std::size_t num_elems)
+{
+  const __m256 constant_vec = _mm256_set1_ps(constant);
+  std::size_t iter = 0u;
+  for (; iter + 8u <= num_elems; iter += 8u)
+  {  _mm256_storeu_ps(result + iter, _mm256_mul_ps(_mm256_loadu_ps(left + iter), constant_vec));  }
+  simd_mul_const_scalar(left + iter, constant, result + iter, num_elems - iter);
+}
+
+__attribute__((target("avx2")))
+void simd_add_avx2(const float* source, float* result, const std::size_t num_elems)
+{
+  std::size_t iter = 0u;
+  for (; iter + 8u <= num_elems; iter += 8u)
+  {  _mm256_storeu_ps(result + iter, _mm256_add_ps(_mm256_loadu_ps(result + iter), _mm256_loadu_ps(source + iter)));  }
+  simd_add_scalar(source + iter, result + iter, num_elems - iter);
+}
+
+__attribute__((target("avx2")))
+float simd_sum_avx2(const float* source, const std::size_t num_elems)
+{
+  // two independent accumulators to hide the add latency
+  __m256 sum_vec1 = _mm256_setzero_ps();
+  __m256 sum_vec2 = _mm256_setzero_ps();
+  std::size_t iter = 0u;
+  for (; iter + 16u <= num_elems; iter += 16u)
+  {
+    sum_vec1 = _mm256_add_ps(sum_vec1, _mm256_loadu_ps(source + iter));
+    sum_vec2 = _mm256_add_ps(sum_vec2, _mm256_loadu_ps(source + iter + 8u));
+  }
+  sum_vec1 = _mm256_add_ps(sum_vec1, sum_vec2);
+
+  __m128 sum_half = _mm_add_ps(_mm256_castps256_ps128(sum_vec1), _mm256_extractf128_ps(sum_vec1, 1));
+  sum_half = _mm_add_ps(sum_half, _mm_movehl_ps(sum_half, sum_half));
+  sum_half = _mm_add_ss(sum_half, _mm_shuffle_ps(sum_half, sum_half, 0x55));
+  return _mm_cvtss_f32(sum_half) + simd_sum_scalar(source + iter, num_elems - iter);
+}
+
+__attribute__((target("avx2")))
+void simd_divide_avx2(float* values, const float constant, const std::size_t num_elems)
+{
+  const __m256 constant_vec = _mm256_set1_ps(constant);
+  std::size_t iter = 0u;
+  for (; iter + 8u <= num_elems; iter += 8u)
+  {  _mm256_storeu_ps(values + iter, _mm256_div_ps(_mm256_loadu_ps(values + iter), constant_vec));  }
+  simd_divide_scalar(values + iter, constant, num_elems - iter);
+}
+
+
+/* ---- AVX-512 kernels, 16 floats per step ---- */
+
+__attribute__((target("avx512f")))
+void simd_mul_avx512(const float* left, const float* right, float* result, const std::size_t num_elems)
+{
+  std::size_t iter = 0u;
+  for (; iter + 16u <= num_elems; iter += 16u)
+  {  _mm512_storeu_ps(result + iter, _mm512_mul_ps(_mm512_loadu_ps(left + iter), _mm512_loadu_ps(right + iter)));  }
+  simd_mul_scalar(left + iter, right + iter, result + iter, num_elems - iter);
+}
+
+__attribute__((target("avx512f")))
+void simd_mul_const_avx512(const float* left, const float constant, float* result, const std::size_t num_elems)
+{
+  const __m512 constant_vec = _mm512_set1_ps(constant);
+  std::size_t iter = 0u;
+  for (; iter + 16u <= num_elems; iter += 16u)
+  {  _mm512_storeu_ps(result + iter, _mm512_mul_ps(_mm512_loadu_ps(left + iter), constant_vec));  }
+  simd_mul_const_scalar(left + iter, constant, result + iter, num_elems - iter);
+}
+
+__attribute__((target("avx512f")))
+void simd_add_avx512(const float* source, float* result, const std::size_t num_elems)
+{
+  std::size_t iter = 0u;
+  for (; iter + 16u <= num_elems; iter += 16u)
+  {  _mm512_storeu_ps(result + iter, _mm512_add_ps(_mm512_loadu_ps(result + iter), _mm512_loadu_ps(source + iter)));  }
+  simd_add_scalar(source + iter, result + iter, num_elems - iter);
+}
+
+__attribute__((target("avx512f")))
+float simd_sum_avx512(const float* source, const std::size_t num_elems)
+{
+  __m512 sum_vec1 = _mm512_setzero_ps();
+  __m512 sum_vec2 = _mm512_setzero_ps();
+  std::size_t iter = 0u;
+  for (; iter + 32u <= num_elems; iter += 32u)
+  {
+    sum_vec1 = _mm512_add_ps(sum_vec1, _mm512_loadu_ps(source + iter));
+    sum_vec2 = _mm512_add_ps(sum_vec2, _mm512_loadu_ps(source + iter + 16u));
+  }
+  sum_vec1 = _mm512_add_ps(sum_vec1, sum_vec2);
+
+  // lanes are only added once per call
+  alignas(64) float lanes[16];
+  _mm512_store_ps(lanes, sum_vec1);
+  return simd_sum_scalar(lanes, 16u) + simd_sum_scalar(source + iter, num_elems - iter);
+}
+
+__attribute__((target("avx512f")))
+void simd_divide_avx512(float* values, const float constant, const std::size_t num_elems)
+{
+  const __m512 constant_vec = _mm512_set1_ps(constant);
+  std::size_t iter = 0u;
+  for (; iter + 16u <= num_elems; iter += 16u)
+  {  _mm512_storeu_ps(values + iter, _mm512_div_ps(_mm512_loadu_ps(values + iter), constant_vec));  }
+  simd_divide_scalar(values + iter, constant, num_elems - iter);
+}
+
+#endif
+
+
+/* ---- run time dispatch ---- */
+
+struct simdKernels
+{
+  simd_level level;
+  void  (*mul)      (const float* left, const float* right, float* result, const std::size_t num_elems);
+  void  (*mul_const)(const float* left, const float constant, float* result, const std::size_t num_elems);
+  void  (*add)      (const float* source, float* result, const std::size_t num_elems);
+  float (*sum)      (const float* source, const std::size_t num_elems);
+  void  (*divide)   (float* values, const float constant, const std::size_t num_elems);
+};
+
+
+simd_level detect_simd_level()
+{
+#if BN_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+  {  return SIMD_AVX512;  }
+  if (__builtin_cpu_supports("avx2"))
+  {  return SIMD_AVX2;  }
+#endif
+  return SIMD_SCALAR;
+}
+
+
+simdKernels make_simd_kernels(const simd_level level)
+{
+  simdKernels kernels {SIMD_SCALAR, simd_mul_scalar, simd_mul_const_scalar, simd_add_scalar, simd_sum_scalar, simd_divide_scalar};
+#if BN_SIMD_X86
+  if (level == SIMD_AVX512)
+  {  kernels = simdKernels{SIMD_AVX512, simd_mul_avx512, simd_mul_const_avx512, simd_add_avx512, simd_sum_avx512, simd_divide_avx512};  }
+  else if (level == SIMD_AVX2)
+  {  kernels = simdKernels{SIMD_AVX2, simd_mul_avx2, simd_mul_const_avx2, simd_add_avx2, simd_sum_avx2, simd_divide_avx2};  }
+#else
+  (void)level;
+#endif
+  return kernels;
+}
+
+
+// one table per level, built once and never written afterwards
+const simdKernels& simd_kernels_of(const simd_level level)
+{
+  static const simdKernels kernels[] = {make_simd_kernels(SIMD_SCALAR), 
+                                        make_simd_kernels(SIMD_AVX2), 
+                                        make_simd_kernels(SIMD_AVX512)};
+  return kernels[level];
+}
+
+
+std::atomic<const simdKernels*>& active_simd_kernels_ptr()
+{
+  static std::atomic<const simdKernels*> active_kernels(&simd_kernels_of(detect_simd_level()));
+  return active_kernels;
+}
+
+
+const simdKernels& active_simd_kernels()
+{
+  return *active_simd_kernels_ptr().load(std::memory_order_acquire);
+}
+
+
+void set_simd_level(const simd_level level)
+{
+  // can only go down from what the CPU supports, mainly for benchmarking against the scalar path.
+  // only the pointer is swapped, a call already running on pool threads keeps the table it started with
+  active_simd_kernels_ptr().store(&simd_kernels_of(std::min(level, detect_simd_level())), std::memory_order_release);
+}
+
+} // end namespace {BN}
+
+#endif
@@ -0,0 +1,537 @@
+#ifndef _BN_SPARSE_FACTOR_H_
+#define _BN_SPARSE_FACTOR_H_
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <utility>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_variable_elimination.h"
+#include "util.h"
+
+namespace BN
+{
+
+// factors with a smaller fraction of non-zero values than this are kept sparse,
+// a sparse entry takes twice the memory of a dense one and is visited out of order
+const float DEFAULT_SPARSE_FILL_RATIO = 0.25f;
+
+
+struct sparseFactor
+{
+  // same scope and linear index layout as BN::factor (first variable changes the fastest)
+  UIntVec variables;
+  UIntVec cardinals;
+
+  // non-zero entries only, indices ascending
+  UIntVec            indices;
+  std::vector<float> values;
+};
+
+
+// holds a factor either dense or sparse, whichever suits its fill ratio
+struct adaptiveFactor
+{
+  bool         is_sparse = false;
+  factor       dense;
+  sparseFactor sparse;
+};
+
+
+float fill_ratio(const factor& factor_elem)
+{
+  if (factor_elem.values.empty() == true)
+  {  return 1.0f;  }
+
+  std::size_t num_non_zero = 0u;
+  for (const float value: factor_elem.values)
+  {
+    if (value != 0.0f)
+    {  num_non_zero++;  }
+  }
+  return static_cast<float>(num_non_zero)/static_cast<float>(factor_elem.values.size());
+}
+
+
+float fill_ratio(const sparseFactor& factor_elem)
+{
+  const UInt table_size = util::vec_prod(factor_elem.cardinals);
+  return static_cast<float>(factor_elem.indices.size())/static_cast<float>(table_size);
+}
+
+
+void to_sparse(const factor&       source,
+                     sparseFactor& dest)
+{
+  dest.variables = source.variables;
+  dest.cardinals = source.cardinals;
+  dest.indices.clear();
+  dest.values.clear();
+  for (std::size_t iter = 0u; iter < source.values.size(); iter++)
+  {
+    if (source.values[iter] != 0.0f)
+    {
+      dest.indices.push_back(static_cast<UInt>(iter));
+      dest.values.push_back(source.values[iter]);
+    }
+  }
+}
+
+
+void to_dense(const sparseFactor& source,
+                    factor&       dest)
+{
+  dest.variables = source.variables;
+  dest.cardinals = source.cardinals;
+  dest.values.assign(util::vec_prod(source.cardinals), 0.0f);
+  for (std::size_t iter = 0u; iter < source.indices.size(); iter++)
+  {  dest.values[source.indices[iter]] = source.values[iter];  }
+}
+
+
+void sort_sparse_entries(std::vector<std::pair<UInt, float>>& entries,
+                         sparseFactor&                        result)
+{
+  // entries with the same index are added up in the order they were produced, zeros are dropped
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const std::pair<UInt, float>& entry1, const std::pair<UInt, float>& entry2)
+                   {  return entry1.first < entry2.first;  });
+
+  result.indices.clear();
+  result.values.clear();
+  for (const std::pair<UInt, float>& entry: entries)
+  {
+    if ((result.indices.empty() == false) && (result.indices.back() == entry.first))
+    {  result.values.back() += entry.second;  }
+    else
+    {
+      result.indices.push_back(entry.first);
+      result.values.push_back(entry.second);
+    }
+  }
+
+  std::size_t num_kept = 0u;
+  for (std::size_t iter = 0u; iter < result.indices.size(); iter++)
+  {
+    if (result.values[iter] != 0.0f)
+    {
+      result.indices[num_kept] = result.indices[iter];
+      result.values[num_kept]  = result.values[iter];
+      num_kept++;
+    }
+  }
+  result.indices.resize(num_kept);
+  result.values.resize(num_kept);
+}
+
+
+UInt get_scope_index(const UInt     index,
+                     const UIntVec& cardinals,
+                     const UIntVec& strides_in_scope)
+{
+  // linear index in another scope of the assignment at index, strides_in_scope is 0 for variables not in it
+  UInt scope_index = 0u, remainder = index;
+  for (std::size_t var_iter = 0u; var_iter < cardinals.size(); var_iter++)
+  {
+    scope_index += (remainder % cardinals[var_iter])*strides_in_scope[var_iter];
+    remainder   /= cardinals[var_iter];
+  }
+  return scope_index;
+}
+
+
+void sparse_factor_product(const sparseFactor& factor_left,
+                           const sparseFactor& factor_right,
+                                 sparseFactor& product_result)
+{
+  // only pairs of non-zero entries that agree on the shared variables are multiplied,
+  // product scope is the left variables followed by the right-only ones (same as factor_product)
+  factor left_scope, right_scope;
+  left_scope.variables  = factor_left.variables;
+  left_scope.cardinals  = factor_left.cardinals;
+  right_scope.variables = factor_right.variables;
+  right_scope.cardinals = factor_right.cardinals;
+
+  factor shared_scope, right_only_scope;
+  for (std::size_t iter = 0u; iter < factor_right.variables.size(); iter++)
+  {
+    int left_index = get_var_index(left_scope, factor_right.variables[iter]);
+    if (left_index == -1)
+    {
+      right_only_scope.variables.push_back(factor_right.variables[iter]);
+      right_only_scope.cardinals.push_back(factor_right.cardinals[iter]);
+    }
+    else if (factor_left.cardinals[left_index] != factor_right.cardinals[iter])
+    {
+      std::cout << "Cardinals don't match, couldn't perform factor product\n";
+      return;
+    }
+    else
+    {
+      shared_scope.variables.push_back(factor_right.variables[iter]);
+      shared_scope.cardinals.push_back(factor_right.cardinals[iter]);
+    }
+  }
+
+  product_result.variables = factor_left.variables;
+  product_result.cardinals = factor_left.cardinals;
+  product_result.variables.insert(product_result.variables.end(), right_only_scope.variables.begin(), right_only_scope.variables.end());
+  product_result.cardinals.insert(product_result.cardinals.end(), right_only_scope.cardinals.begin(), right_only_scope.cardinals.end());
+
+  UIntVec left_shared_strides, right_shared_strides, right_only_strides;
+  get_strides_in_scope(shared_scope,     factor_left.variables,  left_shared_strides);
+  get_strides_in_scope(shared_scope,     factor_right.variables, right_shared_strides);
+  get_strides_in_scope(right_only_scope, factor_right.variables, right_only_strides);
+
+  // right entries bucketed by their shared assignment (counting sort, no hashing)
+  const UInt num_shared   = util::vec_prod(shared_scope.cardinals);
+  const UInt left_size    = util::vec_prod(factor_left.cardinals);
+  const std::size_t num_right = factor_right.indices.size();
+  UIntVec bucket_offsets(num_shared + 1u, 0u);
+  UIntVec right_shared_index(num_right);
+  for (std::size_t iter = 0u; iter < num_right; iter++)
+  {
+    right_shared_index[iter] = get_scope_index(factor_right.indices[iter], factor_right.cardinals, right_shared_strides);
+    bucket_offsets[right_shared_index[iter] + 1u]++;
+  }
+  for (UInt bucket = 0u; bucket < num_shared; bucket++)
+  {  bucket_offsets[bucket + 1u] += bucket_offsets[bucket];  }
+
+  UIntVec bucket_fill(bucket_offsets.begin(), bucket_offsets.end() - 1);
+  UIntVec bucket_entries(num_right);
+  for (std::size_t iter = 0u; iter < num_right; iter++)
+  {  bucket_entries[bucket_fill[right_shared_index[iter]]++] = static_cast<UInt>(iter);  }
+
+  // product index is the left index plus the right-only part scaled by the left table size
+  std::vector<std::pair<UInt, float>> entries;
+  for (std::size_t iter_left = 0u; iter_left < factor_left.indices.size(); iter_left++)
+  {
+    const UInt shared_index = get_scope_index(factor_left.indices[iter_left], factor_left.cardinals, left_shared_strides);
+    for (UInt bucket_iter = bucket_offsets[shared_index]; bucket_iter < bucket_offsets[shared_index + 1u]; bucket_iter++)
+    {
+      const UInt iter_right = bucket_entries[bucket_iter];
+      const UInt right_only_index = get_scope_index(factor_right.indices[iter_right], factor_right.cardinals, right_only_strides);
+      entries.push_back(std::make_pair(factor_left.indices[iter_left] + left_size*right_only_index,
+                                       factor_left.values[iter_left]*factor_right.values[iter_right]));
+    }
+  }
+  sort_sparse_entries(entries, product_result);
+}
+
+
+void sparse_factor_sum_out(const sparseFactor& factor_to_sum,
+                           const UIntVec&      sum_out_vars,
+                                 sparseFactor& sum_result)
+{
+  // result keeps the remaining variables in their original order, only non-zero entries are visited
+  factor result_scope;
+  for (std::size_t iter = 0u; iter < factor_to_sum.variables.size(); iter++)
+  {
+    if (std::find(sum_out_vars.begin(), sum_out_vars.end(), factor_to_sum.variables[iter]) == sum_out_vars.end())
+    {
+      result_scope.variables.push_back(factor_to_sum.variables[iter]);
+      result_scope.cardinals.push_back(factor_to_sum.cardinals[iter]);
+    }
+  }
+
+  UIntVec strides_result;
+  get_strides_in_scope(result_scope, factor_to_sum.variables, strides_result);
+
+  std::vector<std::pair<UInt, float>> entries(factor_to_sum.indices.size());
+  for (std::size_t iter = 0u; iter < factor_to_sum.indices.size(); iter++)
+  {
+    entries[iter] = std::make_pair(get_scope_index(factor_to_sum.indices[iter], factor_to_sum.cardinals, strides_result),
+                                   factor_to_sum.values[iter]);
+  }
+
+  sum_result.variables = result_scope.variables;
+  sum_result.cardinals = result_scope.cardinals;
+  sort_sparse_entries(entries, sum_result);
+}
+
+
+void sparse_factor_reduce(const sparseFactor&          factor_to_reduce,
+                          const std::vector<UIntVec>&  evidence,
+                                sparseFactor&          reduced_result)
+{
+  // entries consistent with the evidence are kept and re-indexed in the reduced scope
+  factor source_scope, reduced_scope;
+  source_scope.variables = factor_to_reduce.variables;
+  source_scope.cardinals = factor_to_reduce.cardinals;
+
+  UIntVec observed_states(factor_to_reduce.variables.size(), 0u);
+  std::vector<bool> is_observed(factor_to_reduce.variables.size(), false);
+  for (std::size_t var_iter = 0u; var_iter < factor_to_reduce.variables.size(); var_iter++)
+  {
+    for (const UIntVec& evidence_elem: evidence)
+    {
+      if (   (evidence_elem[0] == factor_to_reduce.variables[var_iter])
+          && (evidence_elem[1] <  factor_to_reduce.cardinals[var_iter]) )
+      {
+        observed_states[var_iter] = evidence_elem[1];
+        is_observed[var_iter]     = true;
+        break;
+      }
+    }
+    if (is_observed[var_iter] == false)
+    {
+      reduced_scope.variables.push_back(factor_to_reduce.variables[var_iter]);
+      reduced_scope.cardinals.push_back(factor_to_reduce.cardinals[var_iter]);
+    }
+  }
+
+  UIntVec strides_reduced;
+  get_strides_in_scope(reduced_scope, factor_to_reduce.variables, strides_reduced);
+
+  reduced_result.variables = reduced_scope.variables;
+  reduced_result.cardinals = reduced_scope.cardinals;
+  reduced_result.indices.clear();
+  reduced_result.values.clear();
+  for (std::size_t iter = 0u; iter < factor_to_reduce.indices.size(); iter++)
+  {
+    // indices are ascending in the source and the kept variables keep their order, so they stay ascending
+    UInt remainder = factor_to_reduce.indices[iter], reduced_index = 0u;
+    bool is_consistent = true;
+    for (std::size_t var_iter = 0u; var_iter < factor_to_reduce.variables.size(); var_iter++)
+    {
+      const UInt state = remainder % factor_to_reduce.cardinals[var_iter];
+      remainder       /= factor_to_reduce.cardinals[var_iter];
+      if ((is_observed[var_iter] == true) && (state != observed_states[var_iter]))
+      {
+        is_consistent = false;
+        break;
+      }
+      reduced_index += state*strides_reduced[var_iter];
+    }
+    if (is_consistent == true)
+    {
+      reduced_result.indices.push_back(reduced_index);
+      reduced_result.values.push_back(factor_to_reduce.values[iter]);
+    }
+  }
+}
+
+
+/* ---- automatic dense/sparse switch ---- */
+
+void make_adaptive_factor(const factor&         source,
+                                adaptiveFactor& dest,
+                          const float           max_sparse_fill_ratio = DEFAULT_SPARSE_FILL_RATIO)
+{
+  dest.is_sparse = (source.variables.empty() == false) && (fill_ratio(source) < max_sparse_fill_ratio);
+  if (dest.is_sparse == true)
+  {
+    to_sparse(source, dest.sparse);
+    dest.dense = factor();
+  }
+  else
+  {
+    dest.dense  = source;
+    dest.sparse = sparseFactor();
+  }
+}
+
+
+void settle_adaptive_factor(      adaptiveFactor& factor_elem,
+                            const float           max_sparse_fill_ratio)
+{
+  // switches the representation if the fill ratio crossed the threshold
+  if ((factor_elem.is_sparse == true) && (fill_ratio(factor_elem.sparse) >= max_sparse_fill_ratio))
+  {
+    to_dense(factor_elem.sparse, factor_elem.dense);
+    factor_elem.sparse    = sparseFactor();
+    factor_elem.is_sparse = false;
+  }
+  else if (   (factor_elem.is_sparse == false)
+           && (factor_elem.dense.variables.empty() == false)
+           && (fill_ratio(factor_elem.dense) < max_sparse_fill_ratio) )
+  {
+    to_sparse(factor_elem.dense, factor_elem.sparse);
+    factor_elem.dense     = factor();
+    factor_elem.is_sparse = true;
+  }
+}
+
+
+void to_dense(const adaptiveFactor& source,
+                    factor&         dest)
+{
+  if (source.is_sparse == true)
+  {  to_dense(source.sparse, dest);  }
+  else
+  {  dest = source.dense;  }
+}
+
+
+void adaptive_factor_product(const adaptiveFactor& factor_left,
+                             const adaptiveFactor& factor_right,
+                                   adaptiveFactor& product_result,
+                             const float           max_sparse_fill_ratio = DEFAULT_SPARSE_FILL_RATIO)
+{
+  // sparse kernel when the product is expected to be sparse (fill ratios multiply when the
+  // zeros are unrelated), dense kernel otherwise
+  const float left_fill  = factor_left.is_sparse  ? fill_ratio(factor_left.sparse)  : 1.0f;
+  const float right_fill = factor_right.is_sparse ? fill_ratio(factor_right.sparse) : 1.0f;
+
+  if (   (factor_left.is_sparse || factor_right.is_sparse)
+      && (left_fill*right_fill < max_sparse_fill_ratio) )
+  {
+    sparseFactor left_converted, right_converted;
+    if (factor_left.is_sparse == false)   {  to_sparse(factor_left.dense,  left_converted);   }
+    if (factor_right.is_sparse == false)  {  to_sparse(factor_right.dense, right_converted);  }
+
+    sparse_factor_product(factor_left.is_sparse  ? factor_left.sparse  : left_converted,
+                          factor_right.is_sparse ? factor_right.sparse : right_converted,
+                          product_result.sparse);
+    product_result.is_sparse = true;
+  }
+  else
+  {
+    factor left_converted, right_converted;
+    if (factor_left.is_sparse == true)   {  to_dense(factor_left.sparse,  left_converted);   }
+    if (factor_right.is_sparse == true)  {  to_dense(factor_right.sparse, right_converted);  }
+
+    factor_product(factor_left.is_sparse  ? left_converted  : factor_left.dense,
+                   factor_right.is_sparse ? right_converted : factor_right.dense,
+                   product_result.dense);
+    product_result.is_sparse = false;
+  }
+  settle_adaptive_factor(product_result, max_sparse_fill_ratio);
+}
+
+
+void adaptive_factor_sum_out(const adaptiveFactor& factor_to_sum,
+                             const UIntVec&        sum_out_vars,
+                                   adaptiveFactor& sum_result,
+                             const float           max_sparse_fill_ratio = DEFAULT_SPARSE_FILL_RATIO)
+{
+  if (factor_to_sum.is_sparse == true)
+  {  sparse_factor_sum_out(factor_to_sum.sparse, sum_out_vars, sum_result.sparse);  }
+  else
+  {  factor_sum_out(factor_to_sum.dense, sum_out_vars, sum_result.dense);  }
+  sum_result.is_sparse = factor_to_sum.is_sparse;
+  settle_adaptive_factor(sum_result, max_sparse_fill_ratio);
+}
+
+
+const UIntVec& adaptive_variables(const adaptiveFactor& factor_elem)
+{
+  return factor_elem.is_sparse ? factor_elem.sparse.variables : factor_elem.dense.variables;
+}
+
+
+void compute_marginal_adaptive(const std::vector<UInt>&     marginal_vars,
+                               const std::vector<UIntVec>&  evidence,
+                               const std::vector<factor*>&  factor_vec,
+                                     factor&                factor_marg,
+                               const float                  max_sparse_fill_ratio = DEFAULT_SPARSE_FILL_RATIO)
+{
+  // variable elimination where every intermediate is stored dense or sparse by its fill ratio,
+  // deterministic CPDs (and tables after evidence) keep their zeros out of the products
+  if (factor_vec.empty() == true)
+  {
+    std::cout << "Cannot compute marginal, given factor vector is empty";
+    return;
+  }
+
+  std::vector<factor> reduced_factors;
+  reduce_evidence(evidence, factor_vec, reduced_factors);
+
+  std::vector<factor*> reduced_ref_vec;
+  std::vector<adaptiveFactor> factors(reduced_factors.size());
+  std::set<UInt> all_vars;
+  for (std::size_t iter = 0u; iter < reduced_factors.size(); iter++)
+  {
+    reduced_ref_vec.push_back(&reduced_factors[iter]);
+    make_adaptive_factor(reduced_factors[iter], factors[iter], max_sparse_fill_ratio);
+    all_vars.insert(reduced_factors[iter].variables.begin(), reduced_factors[iter].variables.end());
+  }
+
+  UIntVec vars_to_eliminate;
+  get_difference(UIntVec(all_vars.begin(), all_vars.end()), marginal_vars, vars_to_eliminate);
+
+  elimination_stats stats;
+  get_elimination_order(reduced_ref_vec, vars_to_eliminate, MIN_FILL, stats);
+  reduced_factors.clear();
+
+  adaptiveFactor product, temp;
+  for (const UInt var: stats.elimination_order)
+  {
+    bool has_product = false;
+    std::vector<adaptiveFactor> remaining;
+    for (adaptiveFactor& factor_elem: factors)
+    {
+      const UIntVec& factor_vars = adaptive_variables(factor_elem);
+      if (std::find(factor_vars.begin(), factor_vars.end(), var) == factor_vars.end())
+      {
+        remaining.push_back(std::move(factor_elem));
+      }
+      else if (has_product == false)
+      {
+        product     = std::move(factor_elem);
+        has_product = true;
+      }
+      else
+      {
+        adaptive_factor_product(product, factor_elem, temp, max_sparse_fill_ratio);
+        std::swap(product, temp);
+      }
+    }
+    factors = std::move(remaining);
+
+    if (has_product == true)
+    {
+      factors.push_back(adaptiveFactor());
+      adaptive_factor_sum_out(product, UIntVec{var}, factors.back(), max_sparse_fill_ratio);
+    }
+  }
+
+  // remaining factors only mention the query variables (or nothing)
+  adaptiveFactor result;
+  bool has_result = false;
+  for (adaptiveFactor& factor_elem: factors)
+  {
+    if (adaptive_variables(factor_elem).empty() == true)
+    {  continue;  }
+
+    if (has_result == false)
+    {
+      result     = std::move(factor_elem);
+      has_result = true;
+    }
+    else
+    {
+      adaptive_factor_product(result, factor_elem, temp, max_sparse_fill_ratio);
+      std::swap(result, temp);
+    }
+  }
+
+  factor_marg = factor();
+  if (has_result == true)
+  {  to_dense(result, factor_marg);  }
+
+  add_observed_vars(marginal_vars, evidence, factor_vec, factor_marg);
+  factor_normalize(factor_marg);
+}
+
+
+std::ostream& operator<<(std::ostream& os,
+                         const sparseFactor& factor_to_output)
+{
+  os << "vars:       ";
+  for (const UInt var: factor_to_output.variables)   {  os << var << " ";  }
+  os << "\ncardinality: ";
+  for (const UInt card: factor_to_output.cardinals)  {  os << card << " ";  }
+  os << "\nnon-zero:    ";
+  for (std::size_t iter = 0u; iter < factor_to_output.indices.size(); iter++)
+  {  os << factor_to_output.indices[iter] << ":" << factor_to_output.values[iter] << " ";  }
+  os << '\n';
+  return os;
+}
+
+} // end namespace {BN}
+
+#endif
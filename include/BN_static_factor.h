@@ -0,0 +1,314 @@
+#ifndef _BN_STATIC_FACTOR_H_
+#define _BN_STATIC_FACTOR_H_
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "util.h"
+
+namespace BN
+{
+
+constexpr UInt const_prod()
+{  return 1u;  }
+
+template <typename... T>
+constexpr UInt const_prod(const UInt first, const T... rest)
+{  return first*const_prod(rest...);  }
+
+
+// factor with the cardinalities fixed at compile time, meant for small CPDs (1-4 variables)
+// table lives inline (no heap), strides and table size are compile time constants
+// values are arranged the same way as BN::factor, first variable changes the fastest
+template <UInt... Cards>
+struct static_factor
+{
+  static constexpr std::size_t num_vars   = sizeof...(Cards);
+  static constexpr std::size_t num_values = const_prod(Cards...);
+
+  std::array<UInt,  num_vars>   variables;
+  std::array<float, num_values> values;
+
+  static constexpr UInt cardinal(const std::size_t var_index)
+  {
+    return std::array<UInt, num_vars>{{Cards...}}[var_index];
+  }
+
+  static constexpr UInt stride(const std::size_t var_index)
+  {
+    UInt result = 1u;
+    for (std::size_t iter = 0u; iter < var_index; iter++)
+    {  result *= cardinal(iter);  }
+    return result;
+  }
+};
+
+
+template <UInt... Cards>
+static_factor<Cards...> make_static_factor(const std::array<UInt,  sizeof...(Cards)>&     vars,
+                                           const std::array<float, const_prod(Cards...)>& values)
+{
+  static_factor<Cards...> return_elem;
+  return_elem.variables = vars;
+  return_elem.values    = values;
+  return return_elem;
+}
+
+
+template <UInt... Cards>
+int get_var_index(const static_factor<Cards...>& factor_to_find,
+                  const UInt                     var_to_find)
+{
+  for (std::size_t iter = 0u; iter < factor_to_find.variables.size(); iter++)
+  {
+    if (factor_to_find.variables[iter] == var_to_find)
+    {  return static_cast<int>(iter);  }
+  }
+  return -1;
+}
+
+
+template <UInt... Cards>
+void to_factor(const static_factor<Cards...>& source,
+                     factor&                  dest)
+{
+  dest.variables.assign(source.variables.begin(), source.variables.end());
+  dest.cardinals.assign({Cards...});
+  dest.values.assign(source.values.begin(), source.values.end());
+}
+
+
+template <UInt... Cards>
+void from_factor(const factor&            source,
+                 static_factor<Cards...>& dest)
+{
+  if (   (source.cardinals.size() != sizeof...(Cards))
+      || (std::equal(source.cardinals.begin(), source.cardinals.end(), std::array<UInt, sizeof...(Cards)>{{Cards...}}.begin()) == false) )
+  {
+    std::cout << "Cardinals don't match, couldn't convert to static factor\n";
+    return;
+  }
+  // the arrays have a fixed size, a factor with inconsistent variables or values would overrun them
+  if (   (source.variables.size() != static_factor<Cards...>::num_vars)
+      || (source.values.size()    != static_factor<Cards...>::num_values) )
+  {
+    std::cout << "Factor has " << source.variables.size() << " variables and " << source.values.size()
+              << " values, couldn't convert to static factor\n";
+    return;
+  }
+  std::copy(source.variables.begin(), source.variables.end(), dest.variables.begin());
+  std::copy(source.values.begin(),    source.values.end(),    dest.values.begin());
+}
+
+
+/* ---- static x static -> static, every loop bound is a compile time constant ---- */
+
+template <UInt... LeftCards, UInt... RightCards, UInt... ProdCards>
+void factor_product(const static_factor<LeftCards...>&  factor_left,
+                    const static_factor<RightCards...>& factor_right,
+                          static_factor<ProdCards...>&  product_result)
+{
+  typedef static_factor<LeftCards...>  leftType;
+  typedef static_factor<RightCards...> rightType;
+  typedef static_factor<ProdCards...>  prodType;
+
+  // product scope is the left variables followed by the right variables not in left,
+  // declared cardinalities of the result must match this scope
+  std::array<UInt, prodType::num_vars> strides_left {};
+  std::array<UInt, prodType::num_vars> strides_right {};
+  std::size_t num_product_vars = 0u;
+  bool cardinals_match = true;
+
+  for (std::size_t iter = 0u; iter < leftType::num_vars; iter++)
+  {
+    if (num_product_vars < prodType::num_vars)
+    {
+      product_result.variables[num_product_vars] = factor_left.variables[iter];
+      strides_left[num_product_vars] = leftType::stride(iter);
+      cardinals_match &= (prodType::cardinal(num_product_vars) == leftType::cardinal(iter));
+    }
+    num_product_vars++;
+  }
+  for (std::size_t iter = 0u; iter < rightType::num_vars; iter++)
+  {
+    int left_index = get_var_index(factor_left, factor_right.variables[iter]);
+    if (left_index != -1)
+    {
+      if (left_index < static_cast<int>(prodType::num_vars))
+      {  strides_right[left_index] = rightType::stride(iter);  }
+      cardinals_match &= (leftType::cardinal(left_index) == rightType::cardinal(iter));
+    }
+    else
+    {
+      if (num_product_vars < prodType::num_vars)
+      {
+        product_result.variables[num_product_vars] = factor_right.variables[iter];
+        strides_right[num_product_vars] = rightType::stride(iter);
+        cardinals_match &= (prodType::cardinal(num_product_vars) == rightType::cardinal(iter));
+      }
+      num_product_vars++;
+    }
+  }
+
+  if ((num_product_vars != prodType::num_vars) || (cardinals_match == false))
+  {
+    std::cout << "Cardinals don't match, couldn't perform factor product\n";
+    return;
+  }
+
+  std::array<UInt, prodType::num_vars> assignment {};
+  UInt idx_left = 0u, idx_right = 0u;
+  for (std::size_t iter_prod = 0u; iter_prod < prodType::num_values; iter_prod++)
+  {
+    product_result.values[iter_prod] = factor_left.values[idx_left]*factor_right.values[idx_right];
+
+    for (std::size_t var_iter = 0u; var_iter < prodType::num_vars; var_iter++)
+    {
+      assignment[var_iter]++;
+      if (assignment[var_iter] < prodType::cardinal(var_iter))
+      {
+        idx_left  += strides_left[var_iter];
+        idx_right += strides_right[var_iter];
+        break;
+      }
+      assignment[var_iter] = 0u;
+      idx_left  -= (prodType::cardinal(var_iter) - 1u)*strides_left[var_iter];
+      idx_right -= (prodType::cardinal(var_iter) - 1u)*strides_right[var_iter];
+    }
+  }
+}
+
+
+template <UInt... Cards, UInt... SumCards>
+void factor_sum_out(const static_factor<Cards...>&    factor_to_sum,
+                    const UIntVec&                    sum_out_vars,
+                          static_factor<SumCards...>& sum_result)
+{
+  typedef static_factor<Cards...>    sourceType;
+  typedef static_factor<SumCards...> sumType;
+
+  // result keeps the remaining variables in their original order
+  std::array<UInt, sourceType::num_vars> strides_result {};
+  std::size_t num_result_vars = 0u;
+  bool cardinals_match = true;
+  for (std::size_t iter = 0u; iter < sourceType::num_vars; iter++)
+  {
+    if (std::find(sum_out_vars.begin(), sum_out_vars.end(), factor_to_sum.variables[iter]) == sum_out_vars.end())
+    {
+      if (num_result_vars < sumType::num_vars)
+      {
+        sum_result.variables[num_result_vars] = factor_to_sum.variables[iter];
+        strides_result[iter] = sumType::stride(num_result_vars);
+        cardinals_match &= (sumType::cardinal(num_result_vars) == sourceType::cardinal(iter));
+      }
+      num_result_vars++;
+    }
+  }
+
+  if ((num_result_vars != sumType::num_vars) || (cardinals_match == false))
+  {
+    std::cout << "Cardinals don't match, couldn't perform sum out\n";
+    return;
+  }
+
+  sum_result.values.fill(0.0f);
+  std::array<UInt, sourceType::num_vars> assignment {};
+  UInt idx_result = 0u;
+  for (std::size_t iter_source = 0u; iter_source < sourceType::num_values; iter_source++)
+  {
+    sum_result.values[idx_result] += factor_to_sum.values[iter_source];
+
+    for (std::size_t var_iter = 0u; var_iter < sourceType::num_vars; var_iter++)
+    {
+      assignment[var_iter]++;
+      if (assignment[var_iter] < sourceType::cardinal(var_iter))
+      {
+        idx_result += strides_result[var_iter];
+        break;
+      }
+      assignment[var_iter] = 0u;
+      idx_result -= (sourceType::cardinal(var_iter) - 1u)*strides_result[var_iter];
+    }
+  }
+}
+
+
+/* ---- mixed static/dynamic, result is a dynamic BN::factor ---- */
+
+template <UInt... Cards>
+void factor_product(const factor&                  factor_left,
+                    const static_factor<Cards...>& factor_right,
+                          factor&                  product_result)
+{
+  factor right_dynamic;
+  to_factor(factor_right, right_dynamic);
+  factor_product(factor_left, right_dynamic, product_result);
+}
+
+
+template <UInt... Cards>
+void factor_product(const static_factor<Cards...>& factor_left,
+                    const factor&                  factor_right,
+                          factor&                  product_result)
+{
+  factor left_dynamic;
+  to_factor(factor_left, left_dynamic);
+  factor_product(left_dynamic, factor_right, product_result);
+}
+
+
+template <UInt... LeftCards, UInt... RightCards>
+void factor_product(const static_factor<LeftCards...>&  factor_left,
+                    const static_factor<RightCards...>& factor_right,
+                          factor&                       product_result)
+{
+  factor left_dynamic, right_dynamic;
+  to_factor(factor_left,  left_dynamic);
+  to_factor(factor_right, right_dynamic);
+  factor_product(left_dynamic, right_dynamic, product_result);
+}
+
+
+template <UInt... Cards>
+void factor_sum_out(const static_factor<Cards...>& factor_to_sum,
+                    const UIntVec&                 sum_out_vars,
+                          factor&                  sum_result)
+{
+  factor source_dynamic;
+  to_factor(factor_to_sum, source_dynamic);
+  factor_sum_out(source_dynamic, sum_out_vars, sum_result);
+}
+
+
+template <UInt... Cards>
+void factor_marginalize(const static_factor<Cards...>& factor_marginalize,
+                        const UInt                     marginalize_var,
+                              factor&                  marginal_result)
+{
+  factor source_dynamic;
+  to_factor(factor_marginalize, source_dynamic);
+  BN::factor_marginalize(source_dynamic, marginalize_var, marginal_result);
+}
+
+
+template <UInt... Cards>
+std::ostream& operator<<(std::ostream& os,
+                         const static_factor<Cards...>& factor_to_output)
+{
+  os << "vars:       ";
+  for (const UInt var: factor_to_output.variables)   {  os << var << " ";  }
+  os << "\ncardinality: ";
+  for (const UInt card: {Cards...})                  {  os << card << " ";  }
+  os << "\nCpd:         ";
+  for (const float value: factor_to_output.values)   {  os << value << " ";  }
+  os << '\n';
+  return os;
+}
+
+} // end namespace {BN}
+
+#endif
@@ -2,6 +2,7 @@
 #define _BN_TYPES_H_
 
 #include <vector>
+#include <memory>
 
 typedef unsigned int UInt;
 typedef std::vector<unsigned int> UIntVec;
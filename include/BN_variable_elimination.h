@@ -0,0 +1,320 @@
+#ifndef _BN_VARIABLE_ELIMINATION_H_
+#define _BN_VARIABLE_ELIMINATION_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <limits>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_factor_pool.h"
+#include "BN_factor_expression.h"
+#include "util.h"
+
+namespace BN
+{
+
+enum elimination_heuristic
+{
+  MIN_FILL,          // fewest edges added between the neighbours of eliminated var
+  MIN_DEGREE,        // fewest neighbours
+  WEIGHTED_MIN_FILL  // fill edges weighted by product of cardinalities of their end points
+};
+
+
+struct elimination_stats
+{
+  // order in which variables were summed out
+  std::vector<unsigned int> elimination_order;
+
+  // largest (number of neighbours) of a variable at the time of its elimination
+  unsigned int induced_width = 0u;
+
+  // largest number of values in an intermediate product table
+  unsigned long long peak_table_size = 0u;
+};
+
+
+typedef std::map<UInt, std::set<UInt>> interactionGraph;
+
+
+void build_interaction_graph(const std::vector<factor*>& factor_vec,
+                                   interactionGraph&     graph,
+                                   std::map<UInt, UInt>& var_cardinals)
+{
+  // every pair of variables that appear together in a factor are neighbours
+  for (const factor* factor_ptr: factor_vec)
+  {
+    for (std::size_t iter1 = 0u; iter1 < factor_ptr->variables.size(); iter1++)
+    {
+      const UInt var = factor_ptr->variables[iter1];
+      var_cardinals[var] = factor_ptr->cardinals[iter1];
+      graph[var];
+
+      for (std::size_t iter2 = 0u; iter2 < factor_ptr->variables.size(); iter2++)
+      {
+        if (iter1 != iter2)
+        {  graph[var].insert(factor_ptr->variables[iter2]);  }
+      }
+    }
+  }
+}
+
+
+unsigned long long elimination_cost(const interactionGraph&     graph,
+                                    const std::map<UInt, UInt>& var_cardinals,
+                                    const UInt                  var,
+                                    const elimination_heuristic heuristic)
+{
+  const std::set<UInt>& neighbours = graph.at(var);
+  if (heuristic == MIN_DEGREE)
+  {  return neighbours.size();  }
+
+  unsigned long long cost = 0u;
+  for (std::set<UInt>::const_iterator iter1 = neighbours.begin(); iter1 != neighbours.end(); iter1++)
+  {
+    std::set<UInt>::const_iterator iter2 = iter1;
+    for (++iter2; iter2 != neighbours.end(); iter2++)
+    {
+      if (graph.at(*iter1).count(*iter2) == 0u)
+      {
+        if (heuristic == WEIGHTED_MIN_FILL)
+        {  cost += static_cast<unsigned long long>(var_cardinals.at(*iter1)) * var_cardinals.at(*iter2);  }
+        else
+        {  cost += 1u;  }
+      }
+    }
+  }
+  return cost;
+}
+
+
+void get_elimination_order(const std::vector<factor*>&   factor_vec,
+                           const UIntVec&                vars_to_eliminate,
+                           const elimination_heuristic   heuristic,
+                                 elimination_stats&      stats)
+{
+  interactionGraph     graph;
+  std::map<UInt, UInt> var_cardinals;
+  build_interaction_graph(factor_vec, graph, var_cardinals);
+
+  std::set<UInt> remaining;
+  for (const UInt var: vars_to_eliminate)
+  {
+    if (graph.find(var) != graph.end())
+    {  remaining.insert(var);  }
+  }
+
+  stats = elimination_stats();
+  stats.elimination_order.reserve(remaining.size());
+
+  while (remaining.empty() == false)
+  {
+    // greedy pick, ties are broken by smallest variable index
+    UInt best_var = *remaining.begin();
+    unsigned long long best_cost = std::numeric_limits<unsigned long long>::max();
+    for (const UInt var: remaining)
+    {
+      unsigned long long cost = elimination_cost(graph, var_cardinals, var, heuristic);
+      if (cost < best_cost)
+      {
+        best_cost = cost;
+        best_var  = var;
+      }
+    }
+
+    // connect all the neighbours of best_var and remove it from graph
+    const std::set<UInt> neighbours = graph[best_var];
+    unsigned long long table_size = var_cardinals[best_var];
+    for (const UInt neighbour: neighbours)
+    {
+      table_size *= var_cardinals[neighbour];
+      graph[neighbour].erase(best_var);
+      for (const UInt other: neighbours)
+      {
+        if (other != neighbour)
+        {  graph[neighbour].insert(other);  }
+      }
+    }
+    graph.erase(best_var);
+    remaining.erase(best_var);
+
+    stats.elimination_order.push_back(best_var);
+    stats.induced_width   = std::max(stats.induced_width, static_cast<UInt>(neighbours.size()));
+    stats.peak_table_size = std::max(stats.peak_table_size, table_size);
+  }
+}
+
+
+typedef void (*factorProductFunction)(const factor&, const factor&, factor&);
+
+
+void eliminate_var(std::vector<factor*>&       factors,
+                   const UInt                  var,
+                         factorPool&           pool,
+                   const factorProductFunction product_function = nullptr)
+{
+  // multiply only the factors that mention var, then sum it out,
+  // every consumed intermediate goes back to the pool.
+  // product_function is for factors that need their own product (batched ones), they are multiplied
+  // pairwise, plain factors are summed straight out of the product without building its table
+  std::size_t num_kept = 0u;
+  if (product_function == nullptr)
+  {
+    std::vector<factor*> bucket;
+    for (std::size_t iter = 0u; iter < factors.size(); iter++)
+    {
+      if (get_var_index(*factors[iter], var) == -1)
+      {  factors[num_kept++] = factors[iter];  }
+      else
+      {  bucket.push_back(factors[iter]);  }
+    }
+    factors.resize(num_kept);
+
+    if (bucket.empty() == false)
+    {
+      factor& sum_result = pool_acquire(pool);
+      factor_product_sum_out(std::vector<const factor*>(bucket.begin(), bucket.end()), UIntVec{var}, sum_result);
+      for (factor* factor_ptr: bucket)
+      {  pool_release(pool, *factor_ptr);  }
+      factors.push_back(&sum_result);
+    }
+    return;
+  }
+
+  factor* product = nullptr;
+  for (std::size_t iter = 0u; iter < factors.size(); iter++)
+  {
+    factor* factor_ptr = factors[iter];
+    if (get_var_index(*factor_ptr, var) == -1)
+    {
+      factors[num_kept] = factor_ptr;
+      num_kept++;
+    }
+    else if (product == nullptr)
+    {
+      product = factor_ptr;
+    }
+    else
+    {
+      factor& product_result = pool_acquire(pool);
+      product_function(*product, *factor_ptr, product_result);
+      pool_release(pool, *product);
+      pool_release(pool, *factor_ptr);
+      product = &product_result;
+    }
+  }
+  factors.resize(num_kept);
+
+  if (product != nullptr)
+  {
+    factor& sum_result = pool_acquire(pool);
+    factor_sum_out(*product, UIntVec{var}, sum_result);
+    pool_release(pool, *product);
+    factors.push_back(&sum_result);
+  }
+}
+
+
+void compute_marginal_ve(const std::vector<UInt>&     marginal_vars,
+                         const std::vector<UIntVec>&  evidence,
+                         const std::vector<factor*>&  factor_vec,
+                               factor&                factor_marg,
+                         const elimination_heuristic  heuristic,
+                               factorPool&            pool,
+                               elimination_stats&     stats)
+{
+  if (factor_vec.empty() == true)
+  {
+    std::cout << "Cannot compute marginal, given factor vector is empty";
+    return;
+  }
+
+  // observed variables are sliced out into pool owned copies, callers factors are not modified,
+  // factors left without any variable are constants and are dropped
+  std::vector<factor*> factors;
+  factors.reserve(factor_vec.size());
+  for (const factor* factor_ptr: factor_vec)
+  {
+    factor& reduced = pool_acquire(pool);
+    factor_reduce(*factor_ptr, evidence, reduced);
+    if (reduced.variables.empty() == true)
+    {  pool_release(pool, reduced);  }
+    else
+    {  factors.push_back(&reduced);  }
+  }
+
+  // every variable other than the query variables is eliminated
+  std::set<UInt> all_vars;
+  for (const factor* factor_ptr: factors)
+  {  all_vars.insert(factor_ptr->variables.begin(), factor_ptr->variables.end());  }
+
+  UIntVec vars_to_eliminate;
+  get_difference(UIntVec(all_vars.begin(), all_vars.end()),
+                 marginal_vars,
+                 vars_to_eliminate);
+
+  get_elimination_order(factors, vars_to_eliminate, heuristic, stats);
+
+  for (const UInt var: stats.elimination_order)
+  {
+    eliminate_var(factors, var, pool);
+  }
+
+  // whatever is left only mentions the query variables,
+  // factors with every variable summed out are constants and drop out in normalization
+  factor* result = nullptr;
+  for (factor* factor_ptr: factors)
+  {
+    if (factor_ptr->variables.empty() == true)
+    {  continue;  }
+
+    if (result == nullptr)
+    {  result = factor_ptr;  }
+    else
+    {
+      factor& product_result = pool_acquire(pool);
+      factor_product(*result, *factor_ptr, product_result);
+      result = &product_result;
+    }
+  }
+
+  // result is handed over by swapping storage with the pool, no copy of the table
+  factor_marg.variables.clear();
+  factor_marg.cardinals.clear();
+  factor_marg.values.clear();
+  if (result != nullptr)
+  {  std::swap(factor_marg, *result);  }
+  pool_release_all(pool);
+
+  add_observed_vars(marginal_vars, evidence, factor_vec, factor_marg);
+  factor_normalize(factor_marg);
+}
+
+
+void compute_marginal_ve(const std::vector<UInt>&     marginal_vars,
+                         const std::vector<UIntVec>&  evidence,
+                         const std::vector<factor*>&  factor_vec,
+                               factor&                factor_marg,
+                         const elimination_heuristic  heuristic,
+                               elimination_stats&     stats)
+{
+  factorPool pool;
+  compute_marginal_ve(marginal_vars, evidence, factor_vec, factor_marg, heuristic, pool, stats);
+}
+
+
+void compute_marginal_ve(const std::vector<UInt>&     marginal_vars,
+                         const std::vector<UIntVec>&  evidence,
+                         const std::vector<factor*>&  factor_vec,
+                               factor&                factor_marg)
+{
+  elimination_stats stats;
+  compute_marginal_ve(marginal_vars, evidence, factor_vec, factor_marg, MIN_FILL, stats);
+}
+
+} // end namespace {BN}
+
+#endif
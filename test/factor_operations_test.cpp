@@ -1,9 +1,17 @@
 #include <iostream>
 #include <vector>
+#include <string>
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 
 #include "BN_types.h"
 #include "BN_operations.h"
+#include "BN_static_factor.h"
+#include "BN_sparse_factor.h"
+#include "BN_decision_diagram.h"
+#include "BN_factor_store.h"
+#include "BN_factor_expression.h"
 #include "util.h"
 
 using namespace BN;
@@ -24,6 +32,16 @@ int main()
   factor_product(sample_factor1, sample_factor2, product_result);
   std::cout << "product_result: \n" << product_result;
 
+  /*
+  -- FACTOR PRODUCT (no shared variables) --
+  output should be,
+  'variables': {0, 3}, 'cardinals': {2, 2}, 'values': {0.033 0.267 0.077 0.623}
+  */
+  factor sample_factor5 = make_factor_with_val({3}, {2}, {0.3f, 0.7f});
+  factor product_result_disjoint;
+  factor_product(sample_factor1, sample_factor5, product_result_disjoint);
+  std::cout << "product_result (disjoint): \n" << product_result_disjoint;
+
 
   /*
   -- FACTOR MARGINALIZATION --
@@ -43,8 +61,50 @@ int main()
   factor sample_factor4_marginal;
   factor_marginalize(sample_factor4, 1, sample_factor4_marginal);
   std::cout << "marginalized_result: \n" << sample_factor4_marginal;
+
+  /*
+  -- FACTOR SUM-OUT (multiple variables in one pass) --
+  output should be,
+  'variables': {2}, 'cardinals': {2}, 'values': {0.62 0.97}
+  */
+  factor sample_factor4_sum_out;
+  factor_sum_out(sample_factor4, {0, 1}, sample_factor4_sum_out);
+  std::cout << "sum_out_result: \n" << sample_factor4_sum_out;
+
+  /*
+  -- FUSED PRODUCT AND SUM-OUT --
+  sum_out(0, f1 * f2) is evaluated straight into the result, the {0, 1} product table is never built,
+  output should be,
+  'variables': {1}, 'cardinals': {2}, 'values': {0.2607 0.7393}
+  */
+  factor fused_sum_out;
+  evaluate(sum_out(0u, sample_factor1 * sample_factor2), fused_sum_out);
+  std::cout << "fused sum_out_result: \n" << fused_sum_out;
   
 
+  /*
+  -- STATIC FACTOR PRODUCT AND SUM-OUT --
+  same factors as the product above with compile time cardinalities, output should be,
+  'variables': {0, 1}, 'cardinals': {2, 2}, 'values': {0.0649, 0.1958, 0.0451, 0.6942}
+  and after summing out 0,
+  'variables': {1}, 'cardinals': {2}, 'values': {0.2607 0.7393}
+  */
+  static_factor<2>    static_factor1 = make_static_factor<2>({0}, {0.11f, 0.89f});
+  static_factor<2, 2> static_factor2 = make_static_factor<2, 2>({1, 0}, {0.59f, 0.41f, 0.22f, 0.78f});
+
+  static_factor<2, 2> static_product;
+  factor_product(static_factor1, static_factor2, static_product);
+  std::cout << "static product_result: \n" << static_product;
+
+  static_factor<2> static_marginal;
+  factor_sum_out(static_product, {0}, static_marginal);
+  std::cout << "static sum_out_result: \n" << static_marginal;
+
+  // static factors mix with the dynamic ones, result is a dynamic factor
+  factor mixed_product;
+  factor_product(sample_factor3, static_marginal, mixed_product);
+  std::cout << "mixed product_result: \n" << mixed_product;
+
   std::vector<factor*> factor_vec {&sample_factor1, &sample_factor2, &sample_factor3};
   
   /* Compute Joint probability */
@@ -58,8 +118,71 @@ int main()
   compute_marginal({1, 2}, {{0, 1}}, factor_vec, marginal_factor);
   std::cout << "Marginalized with evidence: \n" << marginal_factor << '\n';
 
+  /*
+  -- EVIDENCE REDUCTION --
+  observed variable is sliced out of the factor, output should be,
+  'variables': {0, 2}, 'cardinals': {3, 2}, 'values': {0.08 0 0.09 0.16 0 0.18}
+  */
+  factor sample_factor4_reduced;
+  factor_reduce(sample_factor4, {{1u, 1u}}, sample_factor4_reduced);
+  std::cout << "reduced_result: \n" << sample_factor4_reduced << '\n';
+
+  /*
+  -- SPARSE FACTORS --
+  deterministic CPD P(phenotype | genotype), only the non-zero entries are stored and multiplied,
+  output should be,
+  product non-zero: 0:0.25 1:0.5 5:0.25
+  sum out genotype, 'variables': {4}, 'cardinals': {2}, 'values': {0.75 0.25}
+  */
+  factor genotype_prior  = make_factor_with_val({3}, {3}, {0.25f, 0.5f, 0.25f});
+  factor phenotype_given = make_factor_with_val({3, 4}, {3, 2}, {1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f});
+  sparseFactor sparse_prior, sparse_phenotype, sparse_product, sparse_marginal;
+  to_sparse(genotype_prior,  sparse_prior);
+  to_sparse(phenotype_given, sparse_phenotype);
+  sparse_factor_product(sparse_prior, sparse_phenotype, sparse_product);
+  std::cout << "sparse product_result: \n" << sparse_product;
+
+  factor dense_marginal;
+  sparse_factor_sum_out(sparse_product, {3}, sparse_marginal);
+  to_dense(sparse_marginal, dense_marginal);
+  std::cout << "sparse sum_out_result: \n" << dense_marginal << '\n';
+
+  /*
+  -- DECISION DIAGRAM FACTORS --
+  P(phenotype | genotype) repeats the same block, the diagram only keeps the distinct sub-tables,
+  output should be,
+  diagram nodes: 5
+  sum out genotype, 'variables': {4}, 'cardinals': {2}, 'values': {0.75 0.25}
+  */
+  addManager manager;
+  addFactor add_prior, add_phenotype, add_product, add_marginal;
+  to_add_factor(genotype_prior,  manager, add_prior);
+  to_add_factor(phenotype_given, manager, add_phenotype);
+  std::cout << "diagram nodes: " << add_num_nodes(manager, add_phenotype.root) << '\n';
+
+  add_factor_product(manager, add_prior, add_phenotype, add_product);
+  add_factor_sum_out(manager, add_product, {3}, add_marginal);
+  to_factor(manager, add_marginal, dense_marginal);
+  std::cout << "diagram sum_out_result: \n" << dense_marginal << '\n';
+
+  /*
+  -- BINARY FACTOR STORE --
+  factors are written once and loaded back as read-only views into the mapped file,
+  output should match sample_factor2
+  */
+  const char* temp_dir = std::getenv("TMPDIR");
+  if (temp_dir == nullptr)  {  temp_dir = std::getenv("TEMP");  }
+  const std::string store_path = std::string((temp_dir != nullptr) ? temp_dir : "/tmp") + "/factor_store_test.bnfs";
+
+  write_factor_store(store_path, factor_vec);
+  factorStore store;
+  if (open_factor_store(store_path, store) == true)
+  {  std::cout << "stored factor 1: \n" << store.factors[1] << '\n';  }
+
   /* Given an evidence, {variable, state}, this function removes those instance */
   observe_evidence({ {1u, 0u}, {2u, 1u} }, factor_vec);
   std::cout << "after observing evidence: \n" << factor_vec << '\n';
 
+  close_factor_store(store);
+  std::remove(store_path.c_str());
 }
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_variable_elimination.h"
+#include "BN_junction_tree.h"
+#include "BN_batch.h"
+#include "BN_arithmetic_circuit.h"
+#include "BN_noisy_max.h"
+#include "BN_relevance.h"
+#include "BN_map_inference.h"
+#include "BN_recursive_conditioning.h"
+#include "util.h"
+
+using namespace BN;
+using namespace util;
+
+int main()
+{
+  factor sample_factor1 = make_factor_with_val({0}, {2}, {0.11f, 0.89f});
+  factor sample_factor2 = make_factor_with_val({1, 0}, {2, 2}, {0.59f, 0.41f, 0.22f, 0.78f});
+  factor sample_factor3 = make_factor_with_val({2, 1}, {2, 2}, {0.39f, 0.61f, 0.06f, 0.94f});
+
+  std::vector<factor*> factor_vec {&sample_factor1, &sample_factor2, &sample_factor3};
+
+  /* 
+  -- VARIABLE ELIMINATION --
+  output should match compute_marginal,
+  'variables': {1, 2}, 'cardinals': {2, 2}, 'values': {0.0858 0.0468 0.1342 0.7332}
+  */
+  factor marginal_ve;
+  elimination_stats stats;
+  compute_marginal_ve({1, 2}, {{0, 1}}, factor_vec, marginal_ve, MIN_FILL, stats);
+  std::cout << "Variable elimination with evidence: \n" << marginal_ve;
+  std::cout << "elimination order: " << stats.elimination_order 
+            << "induced width: "     << stats.induced_width 
+            << " peak table size: "  << stats.peak_table_size << "\n\n";
+
+  /*
+  output should be,
+  'variables': {2}, 'cardinals': {2}, 'values': {0.146031 0.853969}
+  */
+  factor marginal_ve_single;
+  compute_marginal_ve({2}, {}, factor_vec, marginal_ve_single, MIN_DEGREE, stats);
+  std::cout << "Variable elimination without evidence: \n" << marginal_ve_single;
+  std::cout << "elimination order: " << stats.elimination_order 
+            << "induced width: "     << stats.induced_width 
+            << " peak table size: "  << stats.peak_table_size << "\n\n";
+
+  /*
+  -- VARIABLE ELIMINATION WITH FACTOR POOL --
+  intermediates of repeated queries reuse the storage of the previous query,
+  second query should create no new factors
+  */
+  factorPool pool;
+  for (UInt query_iter = 0u; query_iter < 2u; query_iter++)
+  {
+    compute_marginal_ve({2}, {{0, query_iter}}, factor_vec, marginal_ve_single, MIN_FILL, pool, stats);
+    std::cout << "Pooled variable elimination: \n" << marginal_ve_single;
+    std::cout << "factors created: "  << pool.stats.factors_created
+              << " factors reused: "  << pool.stats.factors_reused
+              << " table growths: "   << pool.stats.table_growths
+              << " peak in use: "     << pool.stats.peak_in_use << "\n";
+  }
+  std::cout << '\n';
+
+  /*
+  -- JUNCTION TREE --
+  compiled once, calibrated for each evidence set, output should be,
+  without evidence: var 1 -> {0.2607 0.7393},  var 2 -> {0.146031 0.853969}
+  with evidence:    var 1 -> {0.22 0.78},      var 2 -> {0.1326 0.8674}
+  */
+  junctionTree tree;
+  build_junction_tree(factor_vec, MIN_FILL, tree);
+
+  std::map<UInt, factor> all_marginals;
+  compute_all_marginals({}, tree, all_marginals);
+  std::cout << "Junction tree without evidence: \n" << all_marginals[1] << all_marginals[2];
+
+  compute_all_marginals({{0, 1}}, tree, all_marginals);
+  std::cout << "Junction tree with evidence: \n" << all_marginals[1] << all_marginals[2];
+
+  /*
+  -- BATCHED EVIDENCE --
+  three evidence cases in one elimination sweep, output should be,
+  case 0 (no evidence): var 2 -> {0.146031 0.853969}
+  case 1 (0 = 1):       var 2 -> {0.1326 0.8674}
+  case 2 (1 = 0):       var 2 -> {0.39 0.61}
+  */
+  std::vector<factor> batch_marginals;
+  compute_marginal_batch({2}, {{}, {{0, 1}}, {{1, 0}}}, factor_vec, batch_marginals);
+  std::cout << "\nBatched evidence: \n";
+  for (const factor& case_marginal: batch_marginals)
+  {  std::cout << case_marginal;  }
+
+  /*
+  -- ARITHMETIC CIRCUIT --
+  compiled once, one upward and one downward pass per evidence set, output should match the junction tree,
+  with evidence: P(evidence) = 0.89, var 1 -> {0.22 0.78}, var 2 -> {0.1326 0.8674}
+  */
+  arithmeticCircuit circuit;
+  compile_arithmetic_circuit(factor_vec, MIN_FILL, circuit);
+  compute_all_marginals({{0, 1}}, circuit, all_marginals);
+  std::cout << "\nArithmetic circuit with evidence: \n" << all_marginals[1] << all_marginals[2];
+  std::cout << "P(evidence): " << circuit.evidence_probability
+            << " circuit nodes: " << circuit.node_types.size()
+            << " circuit edges: " << circuit.children.size() << '\n';
+
+  /*
+  -- NOISY-OR --
+  child 40 with 40 parents (each on with 0.5, inhibitor 0.9, leak 0.01), decomposed into a chain of
+  small factors instead of a 2^41 table, output should be,
+  'variables': {40}, 'cardinals': {2}, 'values': {0.127227 0.872773}
+  */
+  UIntVec noisy_parents;
+  std::vector<factor> noisy_factors;
+  for (UInt parent = 0u; parent < 40u; parent++)
+  {
+    noisy_parents.push_back(parent);
+    noisy_factors.push_back(make_factor_with_val({parent}, {2}, {0.5f, 0.5f}));
+  }
+  noisyMaxCpd noisy_or;
+  make_noisy_or(40u, noisy_parents, std::vector<float>(40u, 0.9f), 0.01f, noisy_or);
+
+  std::vector<factor> chain_factors;
+  UIntVec aux_vars;
+  decompose_noisy_max(noisy_or, 41u, chain_factors, aux_vars);
+
+  std::vector<factor*> noisy_factor_vec;
+  for (factor& factor_elem: noisy_factors)  {  noisy_factor_vec.push_back(&factor_elem);  }
+  for (factor& factor_elem: chain_factors)  {  noisy_factor_vec.push_back(&factor_elem);  }
+
+  factor noisy_marginal;
+  compute_marginal_ve({40u}, {}, noisy_factor_vec, noisy_marginal);
+  std::cout << "\nNoisy-OR with 40 parents: \n" << noisy_marginal;
+
+  /*
+  -- RELEVANCE PRUNING --
+  network 0 -> 1 -> 2, node 2 is barren for a query on 1 without evidence and is never multiplied,
+  output should be,
+  relevant factors: 2
+  'variables': {1}, 'cardinals': {2}, 'values': {0.2607 0.7393}
+  */
+  std::map<std::string, std::shared_ptr<networkNode>> network;
+  network["A"] = std::make_shared<networkNode>(0u);
+  network["B"] = std::make_shared<networkNode>(1u);
+  network["C"] = std::make_shared<networkNode>(2u);
+  add_edge(network, "A", "B");
+  add_edge(network, "B", "C");
+
+  std::vector<factor*> relevant_factors;
+  std::vector<UIntVec> relevant_evidence;
+  get_relevant_factors(network, {1}, {}, factor_vec, relevant_factors, relevant_evidence);
+  std::cout << "\nrelevant factors: " << relevant_factors.size() << '\n';
+
+  factor pruned_marginal;
+  compute_marginal_pruned({1}, {}, network, factor_vec, pruned_marginal);
+  std::cout << "Pruned marginal: \n" << pruned_marginal;
+
+  /*
+  -- MPE / MAP --
+  most probable joint assignment by max-product elimination, and the most probable state of 1 alone
+  (0 and 2 summed out) by branch and bound with mini-buckets of 1 variable, output should be,
+  MPE: {0, 1} {1, 1} {2, 1}  probability 0.652548
+  MAP of 1: {1, 1}  probability 0.7393
+  */
+  std::vector<UIntVec> mpe_assignment;
+  float mpe_probability;
+  compute_mpe_ve({}, factor_vec, mpe_assignment, mpe_probability);
+  std::cout << "\nMPE: " << mpe_assignment << " probability " << mpe_probability << '\n';
+
+  std::vector<UIntVec> map_assignment;
+  float map_probability;
+  mapSearchStats map_stats;
+  compute_map_bnb({1}, {}, factor_vec, 1u, map_assignment, map_probability, map_stats);
+  std::cout << "MAP of 1: " << map_assignment << " probability " << map_probability
+            << " nodes expanded: " << map_stats.nodes_expanded
+            << " nodes pruned: "   << map_stats.nodes_pruned << '\n';
+
+  /*
+  -- RECURSIVE CONDITIONING --
+  4x4 grid network, every variable has its left and upper neighbours as parents,
+  marginal of the last variable without any cache (linear space) and with a cache budget of 1 KiB,
+  both should match variable elimination, 'values': {0.4009 0.5991},
+  the cached run needs far fewer recursive calls (31458 without cache)
+  */
+  std::vector<factor> grid_factors;
+  for (UInt var = 0u; var < 16u; var++)
+  {
+    factor grid_factor = make_factor({var}, {2});
+    if (var % 4u != 0u)  {  grid_factor.variables.push_back(var - 1u);  grid_factor.cardinals.push_back(2u);  }
+    if (var >= 4u)       {  grid_factor.variables.push_back(var - 4u);  grid_factor.cardinals.push_back(2u);  }
+    grid_factor.values.resize(vec_prod(grid_factor.cardinals));
+    for (std::size_t iter = 0u; iter < grid_factor.values.size(); iter += 2u)
+    {
+      grid_factor.values[iter]      = 0.1f + 0.2f*static_cast<float>((iter/2u + var) % 4u);
+      grid_factor.values[iter + 1u] = 1.0f - grid_factor.values[iter];
+    }
+    grid_factors.push_back(grid_factor);
+  }
+  std::vector<factor*> grid_factor_vec;
+  for (factor& factor_elem: grid_factors)  {  grid_factor_vec.push_back(&factor_elem);  }
+
+  factor grid_marginal_ve;
+  compute_marginal_ve({15u}, {}, grid_factor_vec, grid_marginal_ve);
+  std::cout << "\nVariable elimination on grid: \n" << grid_marginal_ve;
+
+  dtree rc_tree;
+  build_dtree(grid_factor_vec, rc_tree);
+
+  factor rc_marginal;
+  rcStats rc_stats;
+  for (const std::size_t memory_budget: {std::size_t(0u), std::size_t(1024u)})
+  {
+    const std::size_t cache_bytes = set_cache_budget(rc_tree, memory_budget);
+    compute_marginal_rc(15u, {}, rc_tree, rc_marginal, rc_stats);
+    std::cout << "Recursive conditioning, cache bytes: " << cache_bytes
+              << " recursive calls: " << rc_stats.recursive_calls
+              << " cache hits: "      << rc_stats.cache_hits << '\n' << rc_marginal;
+  }
+}
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "BN_types.h"
+#include "BN_network_graph.h"
+#include "BN_network_loader.h"
+#include "util.h"
+
+using namespace BN;
+using namespace util;
+
+int main()
+{
+  /*
+  -- COMPACT NETWORK GRAPH --
+  parent1 -> child, parent2 -> child, child -> grandchild
+  ids are interned in order of appearance: parent1 0, child 1, parent2 2, grandchild 3
+  output should be,
+  topological order: 0 2 1 3
+  moral neighbours of parent1: 1 2 (co-parent of child)
+  ancestors of grandchild: 0 1 2 3
+  */
+  networkGraphBuilder builder;
+  add_edge(builder, "parent1", "child");
+  add_edge(builder, "parent2", "child");
+  add_edge(builder, "child",   "grandchild");
+
+  networkGraph graph;
+  build_network_graph(builder, graph);
+
+  UIntVec order;
+  topological_sort(graph, order);
+  std::cout << "topological order: " << order << '\n';
+
+  UIntVec neighbour_offsets, neighbours;
+  moralize(graph, neighbour_offsets, neighbours);
+  std::cout << "moral neighbours of parent1: "
+            << UIntVec(neighbours.begin() + neighbour_offsets[0], neighbours.begin() + neighbour_offsets[1]) << '\n';
+
+  UIntVec ancestors;
+  get_ancestors(graph, {static_cast<UInt>(get_node_id(graph, "grandchild"))}, ancestors);
+  std::cout << "ancestors of grandchild: " << ancestors << '\n';
+
+  /*
+  -- UAI / BIF LOADERS --
+  the same two node network (rain -> wet) in both formats, written here and parsed back,
+  UAI lists the last scope variable fastest, scopes come back reversed so the child is first,
+  output should be (for both files),
+  'variables': {0}, 'cardinals': {2}, 'values': {0.2 0.8}
+  'variables': {1, 0}, 'cardinals': {2, 2}, 'values': {0.9 0.1 0.3 0.7}
+  uai evidence: {1, 0}
+  */
+  // scratch files go to the temp directory and are removed at the end
+  const char* temp_dir = std::getenv("TMPDIR");
+  if (temp_dir == nullptr)  {  temp_dir = std::getenv("TEMP");  }
+  const std::string uai_path      = std::string((temp_dir != nullptr) ? temp_dir : "/tmp") + "/loader_test.uai";
+  const std::string evidence_path = uai_path + ".evid";
+  const std::string bif_path      = std::string((temp_dir != nullptr) ? temp_dir : "/tmp") + "/loader_test.bif";
+
+  std::ofstream(uai_path) << "BAYES\n2\n2 2\n2\n1 0\n2 0 1\n\n2\n 0.2 0.8\n4\n 0.9 0.1\n 0.3 0.7\n";
+  std::ofstream(evidence_path) << "1 1 0\n";
+  std::ofstream(bif_path)
+    << "network rain_test { }\n"
+    << "variable rain { type discrete [ 2 ] { yes, no }; }\n"
+    << "variable wet  { type discrete [ 2 ] { yes, no }; property position = (1, 2); }\n"
+    << "probability ( rain ) { table 0.2, 0.8; }\n"
+    << "// one row per parent state\n"
+    << "probability ( wet | rain ) {\n  (yes) 0.9, 0.1;\n  (no) 0.3, 0.7;\n}\n";
+
+  std::vector<factor> loaded_factors;
+  std::vector<UIntVec> loaded_evidence;
+  networkFileInfo file_info;
+  if (load_uai(uai_path, loaded_factors, file_info) == true)
+  {  std::cout << "uai factors: \n" << loaded_factors[0] << loaded_factors[1] << '\n';  }
+  if (load_uai_evidence(evidence_path, loaded_evidence) == true)
+  {  std::cout << "uai evidence: " << loaded_evidence[0] << '\n';  }
+  if (load_bif(bif_path, loaded_factors, file_info) == true)
+  {  std::cout << "bif factors: \n" << loaded_factors[0] << loaded_factors[1] << '\n';  }
+
+  std::remove(uai_path.c_str());
+  std::remove(evidence_path.c_str());
+  std::remove(bif_path.c_str());
+}
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "BN_types.h"
+#include "BN_operations.h"
+#include "BN_parallel.h"
+#include "BN_loopy_bp.h"
+#include "BN_sampling.h"
+#include "BN_gibbs.h"
+#include "BN_variable_elimination.h"
+#include "BN_cutset_conditioning.h"
+#include "util.h"
+
+using namespace BN;
+using namespace util;
+
+int main()
+{
+  /*
+  -- PARALLEL FACTOR PRODUCT AND SUM-OUT --
+  threshold is set to 0 so that the small factors are split across the pool,
+  output should match the serial factor_product and factor_sum_out results
+  'variables': {0, 1}, 'cardinals': {2, 2}, 'values': {0.0649, 0.1958, 0.0451, 0.6942}
+  'variables': {2}, 'cardinals': {2}, 'values': {0.62 0.97}
+  */
+  Eigen::ThreadPool pool(4);
+
+  factor sample_factor1 = make_factor_with_val({0}, {2}, {0.11f, 0.89f});
+  factor sample_factor2 = make_factor_with_val({1, 0}, {2, 2}, {0.59f, 0.41f, 0.22f, 0.78f});
+
+  factor product_result;
+  factor_product_parallel(sample_factor1, sample_factor2, product_result, pool, 0u);
+  std::cout << "parallel product_result: \n" << product_result;
+
+  factor sample_factor4 = make_factor_with_val({0, 1, 2}, // vars
+                                               {3, 2, 2}, // cardinals
+                                               {0.25f, 0.05f, 0.15f, 
+                                                0.08f, 0.0f, 0.09f,
+                                                0.35f, 0.07f, 0.21f,
+                                                0.16f, 0.0, 0.18f} // values
+                                                );
+  factor sum_out_result;
+  factor_sum_out_parallel(sample_factor4, {0, 1}, sum_out_result, pool, 0u);
+  std::cout << "parallel sum_out_result: \n" << sum_out_result;
+
+  /* large table, results must be identical for any number of threads */
+  factor large_factor = make_factor({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19},
+                                    {2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2});
+  for (std::size_t iter = 0u; iter < large_factor.values.size(); iter++)
+  {  large_factor.values[iter] = static_cast<float>(iter % 13u)*0.1f;  }
+
+  Eigen::ThreadPool single_thread_pool(1);
+  factor sum_out_single, sum_out_pool;
+  factor_sum_out_parallel(large_factor, {0, 5, 19}, sum_out_single, single_thread_pool);
+  factor_sum_out_parallel(large_factor, {0, 5, 19}, sum_out_pool,   pool);
+  std::cout << "deterministic across thread counts: " 
+            << (sum_out_single.values == sum_out_pool.values ? "true" : "false") << '\n';
+
+  /* same-scope product is one contiguous run, it still has to be split over the pool,
+     output should be 16 chunks (4 threads x CHUNKS_PER_THREAD) and true */
+  factor same_scope_serial, same_scope_pool;
+  factor_product(large_factor, large_factor, same_scope_serial);
+  const std::size_t num_chunks = factor_product_parallel(large_factor, large_factor, same_scope_pool, pool);
+  std::cout << "same-scope product chunks: " << num_chunks
+            << (num_chunks > 1u ? " (split)" : " (NOT split)")
+            << " matches serial: " << (same_scope_serial.values == same_scope_pool.values ? "true" : "false") << '\n';
+
+  /*
+  -- LOOPY BELIEF PROPAGATION --
+  messages are recomputed on the pool (threshold 0), on a tree (0 -> 1 -> 2) the beliefs are exact,
+  with evidence 0 = 1 output should be,
+  'variables': {1}, 'cardinals': {2}, 'values': {0.22 0.78}
+  'variables': {2}, 'cardinals': {2}, 'values': {0.1326 0.8674}
+  */
+  factor sample_factor3 = make_factor_with_val({2, 1}, {2, 2}, {0.39f, 0.61f, 0.06f, 0.94f});
+  std::vector<factor*> factor_vec {&sample_factor1, &sample_factor2, &sample_factor3};
+
+  loopyBeliefPropagation bp;
+  build_loopy_bp(factor_vec, bp);
+
+  bpOptions bp_options;
+  bp_options.min_parallel_messages = 0u;
+  bpTelemetry telemetry;
+  std::map<UInt, factor> beliefs;
+  compute_all_marginals({{0, 1}}, bp, bp_options, pool, beliefs, telemetry);
+  std::cout << "loopy bp beliefs: \n" << beliefs[1] << beliefs[2];
+  std::cout << "converged: "        << (telemetry.converged ? "true" : "false")
+            << " iterations: "      << telemetry.iterations
+            << " message updates: " << telemetry.message_updates
+            << " max residual: "    << telemetry.max_residuals.back() << '\n';
+
+  /*
+  -- LIKELIHOOD WEIGHTING --
+  200000 weighted samples of the same network, every sample only depends on the seed and its index,
+  output should be close to the exact posterior of 2 given 0 = 1, {0.1326 0.8674},
+  and identical for the single thread and the 4 thread pool
+  */
+  factor sampled_single, sampled_pool;
+  compute_marginal_lw({2}, {{0, 1}}, factor_vec, 200000u, 42u, single_thread_pool, sampled_single);
+  compute_marginal_lw({2}, {{0, 1}}, factor_vec, 200000u, 42u, pool,               sampled_pool);
+  std::cout << "likelihood weighting: \n" << sampled_pool;
+  std::cout << "deterministic across thread counts: "
+            << (sampled_single.values == sampled_pool.values ? "true" : "false") << '\n';
+
+  /*
+  -- CHROMATIC GIBBS SAMPLING --
+  0 and 2 don't share a factor and get the same color, 4 chains run on the pool,
+  with evidence 2 = 0 output should be close to the exact posterior,
+  'variables': {0}, 'cardinals': {2}, 'values': {0.1919 0.8081}
+  'variables': {1}, 'cardinals': {2}, 'values': {0.6962 0.3038}
+  */
+  gibbsSampler gibbs;
+  build_gibbs_sampler(factor_vec, gibbs);
+
+  gibbsOptions gibbs_options;
+  gibbs_options.burn_in     = 1000u;
+  gibbs_options.num_samples = 50000u;
+  gibbs_options.thinning    = 2u;
+  gibbs_options.seed        = 7u;
+  std::map<UInt, factor> gibbs_marginals;
+  compute_all_marginals({{2, 0}}, gibbs, gibbs_options, pool, gibbs_marginals);
+  std::cout << "gibbs colors: " << gibbs.color_offsets.size() - 1u << '\n';
+  std::cout << "gibbs marginals: \n" << gibbs_marginals[0] << gibbs_marginals[1];
+
+  /*
+  -- CUTSET CONDITIONING --
+  diamond network 0 -> {1, 2} -> 3 has a single loop, conditioning on 1 breaks it,
+  the 2 instantiations run on the pool, with evidence 3 = 1 output should match variable elimination,
+  'variables': {0}, 'cardinals': {2}, 'values': {0.0611 0.9389}
+  */
+  factor diamond_factor1 = make_factor_with_val({1, 0},    {2, 2},    {0.7f, 0.3f, 0.2f, 0.8f});
+  factor diamond_factor2 = make_factor_with_val({2, 0},    {2, 2},    {0.6f, 0.4f, 0.1f, 0.9f});
+  factor diamond_factor3 = make_factor_with_val({3, 1, 2}, {2, 2, 2}, {0.95f, 0.05f, 0.4f, 0.6f,
+                                                                       0.3f,  0.7f,  0.1f, 0.9f});
+  std::vector<factor*> diamond_vec {&sample_factor1, &diamond_factor1, &diamond_factor2, &diamond_factor3};
+
+  factor diamond_ve, diamond_cutset;
+  cutsetStats cutset_stats;
+  compute_marginal_ve({0}, {{3, 1}}, diamond_vec, diamond_ve);
+  compute_marginal_cutset(0u, {{3, 1}}, diamond_vec, pool, diamond_cutset, cutset_stats);
+  std::cout << "variable elimination: \n" << diamond_ve;
+  std::cout << "cutset conditioning, cutset: " << cutset_stats.cutset
+            << "instantiations: " << cutset_stats.num_instantiations << '\n' << diamond_cutset;
+}